@@ -0,0 +1,662 @@
+#include <QApplication>
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScreen>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "capture.h"
+#include "colorformat.h"
+#include "namedcolors.h"
+#include "overlay.h"
+#include "palette.h"
+#include "pixelwatch.h"
+#include "sampling.h"
+#include "session.h"
+#include "visionfilter.h"
+
+// Benchmarks for the picker's hot paths, printed as one JSON document.
+// Runs on the offscreen platform unless QT_QPA_PLATFORM says otherwise.
+
+namespace {
+
+struct Resolution {
+    const char* name;
+    QSize size;
+};
+
+const Resolution kResolutions[] = {
+    {"1080p", QSize(1920, 1080)},
+    {"4k", QSize(3840, 2160)},
+    {"8k", QSize(7680, 4320)},
+};
+
+struct FormatName {
+    const char* name;
+    ColorFormat format;
+    bool hasReference;  // covered by formatColorReference()
+};
+
+const FormatName kFormats[] = {
+    {"html", ColorFormat::HTML, true},
+    {"hex", ColorFormat::HEX, true},
+    {"delphi", ColorFormat::DelphiHex, true},
+    {"vb", ColorFormat::VBHex, true},
+    {"rgba", ColorFormat::RGBA, true},
+    {"rgb", ColorFormat::RGB, true},
+    {"rgbf", ColorFormat::RGBFloat, true},
+    {"hsv", ColorFormat::HSV, true},
+    {"hsl", ColorFormat::HSL, true},
+    {"lab", ColorFormat::Lab, false},
+    {"oklab", ColorFormat::OKLab, false},
+    {"oklch", ColorFormat::OKLCH, false},
+    {"cmyk", ColorFormat::CMYK, false},
+};
+
+// keeps results alive so the compiler cannot drop the measured work
+volatile quint32 sink = 0;
+
+// xorshift32, deterministic across runs
+class Random {
+   public:
+    explicit Random(quint32 seed = 0x9e3779b9u) : state_(seed) {}
+
+    quint32 next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    int bounded(int limit) { return int(next() % quint32(limit)); }
+
+   private:
+    quint32 state_;
+};
+
+// noise with some flat areas, roughly what a desktop looks like to the kernels
+QImage syntheticScreenshot(const QSize& size) {
+    QImage image(size, QImage::Format_RGB32);
+    Random random;
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        const bool flat = (y / 64) % 3 == 0;
+        for (int x = 0; x < image.width(); ++x) {
+            row[x] = flat ? qRgb(x / 8 % 256, y % 256, 128) : (random.next() | 0xff000000);
+        }
+    }
+    return image;
+}
+
+QJsonObject timings(std::vector<qint64> ns) {
+    QJsonObject result;
+    result["count"] = qint64(ns.size());
+    if (ns.empty()) return result;
+    std::sort(ns.begin(), ns.end());
+    double total = 0;
+    for (qint64 v : ns) total += v;
+    auto percentile = [&](double p) { return ns[std::min(ns.size() - 1, size_t(p * ns.size()))] / 1000.0; };
+    result["mean_us"] = total / ns.size() / 1000.0;
+    result["p50_us"] = percentile(0.50);
+    result["p99_us"] = percentile(0.99);
+    result["max_us"] = ns.back() / 1000.0;
+    return result;
+}
+
+// stands in for an in-process backend: one copy of a prepared frame into the buffer
+class SyntheticCaptureBackend : public CaptureBackend {
+   public:
+    explicit SyntheticCaptureBackend(const QImage& frame) : frame_(frame) {}
+
+    QString name() const override { return "synthetic"; }
+    bool isAvailable() const override { return true; }
+
+    bool capture(const QRect& virtualGeometry, QImage& buffer) override {
+        if (virtualGeometry.size() != frame_.size()) return false;
+        ensureCaptureBuffer(buffer, frame_.size());
+        const size_t rowBytes = size_t(frame_.width()) * 4;
+        for (int y = 0; y < frame_.height(); ++y) {
+            std::memcpy(buffer.scanLine(y), frame_.constScanLine(y), rowBytes);
+        }
+        return true;
+    }
+
+   private:
+    QImage frame_;
+};
+
+// Capture, hand the view to an overlay and paint its first full frame with
+// the magnifier at the centre, which is what the user waits for after a click.
+QJsonObject benchFirstFrame(CaptureBackend* backend, const QRect& geometry, int iterations) {
+    ColorPickerOverlay overlay(QGuiApplication::primaryScreen());
+    overlay.setGeometry(QRect(QPoint(0, 0), geometry.size()));
+    QImage target(geometry.size(), QImage::Format_RGB32);
+    QImage buffer;
+    const QPoint cursor(geometry.width() / 2, geometry.height() / 2);
+
+    std::vector<qint64> ns;
+    int failures = 0;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        if (!backend->capture(geometry, buffer)) {
+            ++failures;
+            continue;
+        }
+        overlay.setScreenshot(captureView(buffer, QRect(QPoint(0, 0), geometry.size())));
+        overlay.beginPick(ColorFormat::HEX, 1);
+        overlay.setCursorPosition(cursor);
+        overlay.render(&target, QPoint(), QRegion(overlay.rect()));
+        ns.push_back(timer.nsecsElapsed());
+        overlay.endPick();
+    }
+
+    QJsonObject result = timings(ns);
+    result["backend"] = backend->name();
+    result["width"] = geometry.width();
+    result["height"] = geometry.height();
+    result["failures"] = failures;
+    return result;
+}
+
+// One cursor move per frame along a smooth path: invalidate (updateDisplay)
+// plus paint of the old and new magnifier area (paintEvent/drawMagnifier),
+// at a given zoom and magnifier size.
+QJsonObject benchFrames(const Resolution& resolution, const QImage& screenshot, int frames, int zoom,
+                        int magnifierSize) {
+    ColorPickerOverlay overlay(QGuiApplication::primaryScreen());
+    overlay.setGeometry(QRect(QPoint(0, 0), resolution.size));
+    overlay.setScreenshot(screenshot);
+    overlay.setMagnifier(zoom, magnifierSize);
+    overlay.beginPick(ColorFormat::HEX, 1);
+    QImage target(resolution.size, QImage::Format_RGB32);
+
+    const int w = resolution.size.width();
+    const int h = resolution.size.height();
+    QRect previous;
+    std::vector<qint64> ns;
+    ns.reserve(frames);
+    for (int i = 0; i < frames; ++i) {
+        const QPoint cursor(w / 2 + int(w / 3 * std::cos(i * 0.010)), h / 2 + int(h / 3 * std::sin(i * 0.017)));
+        QElapsedTimer timer;
+        timer.start();
+        overlay.setCursorPosition(cursor);
+        const QRect bounds = overlay.overlayBounds(cursor);
+        QRegion region(bounds);
+        if (previous.isValid()) region += previous;
+        overlay.render(&target, region.boundingRect().topLeft(), region);
+        ns.push_back(timer.nsecsElapsed());
+        previous = bounds;
+    }
+    overlay.endPick();
+
+    QJsonObject result = timings(ns);
+    result["resolution"] = resolution.name;
+    result["width"] = w;
+    result["height"] = h;
+    result["zoom"] = zoom;
+    result["magnifier"] = magnifierSize;
+    return result;
+}
+
+QJsonArray benchSampling(const Resolution& resolution, const QImage& screenshot, int samples) {
+    QJsonArray results;
+    Random random;
+    std::vector<QPoint> points(samples);
+    for (QPoint& p : points) p = QPoint(random.bounded(screenshot.width()), random.bounded(screenshot.height()));
+
+    auto record = [&](const QString& mode, qint64 ns, int count) {
+        QJsonObject result;
+        result["resolution"] = resolution.name;
+        result["mode"] = mode;
+        result["samples"] = count;
+        result["ns_per_sample"] = double(ns) / count;
+        results.append(result);
+    };
+
+    PixelSampler sampler(screenshot);
+    QElapsedTimer timer;
+    timer.start();
+    quint32 acc = 0;
+    for (const QPoint& p : points) acc += sampler.pixel(p);
+    record("point", timer.nsecsElapsed(), samples);
+    sink = sink + acc;
+
+    timer.restart();
+    auto integral = std::make_shared<IntegralImage>(screenshot);
+    QJsonObject build;
+    build["resolution"] = resolution.name;
+    build["mode"] = "integral_build";
+    build["ms"] = timer.nsecsElapsed() / 1e6;
+    build["bytes"] = qint64(integral->sizeInBytes());
+    results.append(build);
+
+    ColorPickerOverlay overlay(QGuiApplication::primaryScreen());
+    overlay.setGeometry(QRect(QPoint(0, 0), resolution.size));
+    overlay.setScreenshot(screenshot);
+    for (int sampleSize : {5, 31, 101}) {
+        overlay.beginPick(ColorFormat::HEX, sampleSize);
+
+        // the plain loop is what runs until the table is built
+        const int loopSamples = std::max(1, samples / (sampleSize * sampleSize / 25 + 1));
+        timer.restart();
+        for (int i = 0; i < loopSamples; ++i) acc += overlay.sampleColor(points[i]).rgb();
+        record(QString("average %1 (loop)").arg(sampleSize), timer.nsecsElapsed(), loopSamples);
+
+        overlay.setIntegralImage(integral);
+        timer.restart();
+        for (const QPoint& p : points) acc += overlay.sampleColor(p).rgb();
+        record(QString("average %1 (table)").arg(sampleSize), timer.nsecsElapsed(), samples);
+        overlay.endPick();
+        overlay.setScreenshot(screenshot);
+    }
+    sink = sink + acc;
+    return results;
+}
+
+// Live mode's per-frame cost: grabbing the small square under the cursor
+// (magnifier only, and with the largest averaged box) through one backend.
+QJsonArray benchLiveCapture(CaptureBackend* backend, const QRect& desktop, int iterations) {
+    QJsonArray results;
+    QImage buffer;
+    for (int side : {11, 101}) {
+        const QRect rect(desktop.center() - QPoint(side / 2, side / 2), QSize(side, side));
+        std::vector<qint64> ns;
+        bool ok = true;
+        for (int i = 0; i < iterations && ok; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            ok = backend->captureRegion(rect, buffer);
+            ns.push_back(timer.nsecsElapsed());
+        }
+        QJsonObject result = timings(ns);
+        result["backend"] = backend->name();
+        result["side"] = side;
+        if (!ok) result["failed"] = true;
+        results.append(result);
+    }
+    return results;
+}
+
+// One poll of 64 watched points in 8 clusters: a grab per point against the
+// shared grabs mergeWatchRects() makes of them.
+QJsonArray benchWatchGrab(CaptureBackend* backend, const QRect& desktop, int iterations) {
+    std::vector<QRect> points;
+    for (int cluster = 0; cluster < 8; ++cluster) {
+        const QPoint origin = desktop.topLeft() + QPoint(desktop.width() * (cluster + 1) / 10, desktop.height() / 2);
+        for (int i = 0; i < 8; ++i) points.emplace_back(origin + QPoint(i * 6, (i % 3) * 4), QSize(1, 1));
+    }
+
+    QJsonArray results;
+    QImage buffer;
+    for (bool merged : {false, true}) {
+        const std::vector<QRect> rects = merged ? mergeWatchRects(points) : points;
+        std::vector<qint64> ns;
+        bool ok = true;
+        for (int i = 0; i < iterations && ok; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            for (const QRect& rect : rects) ok = ok && backend->captureRegion(rect, buffer);
+            ns.push_back(timer.nsecsElapsed());
+        }
+        QJsonObject result = timings(ns);
+        result["backend"] = backend->name();
+        result["mode"] = merged ? "merged" : "per_point";
+        result["grabs"] = int(rects.size());
+        if (!ok) result["failed"] = true;
+        results.append(result);
+    }
+    return results;
+}
+
+// One vision preview toggle: the whole capture through each mode's filter,
+// checked pixel for pixel against the single-threaded scalar path.
+QJsonArray benchVisionFilter(const Resolution& resolution, const QImage& screenshot, int iterations,
+                             int* mismatches) {
+    QJsonArray results;
+    QImage filtered;
+    QImage reference;
+    for (int m = 1; m < kVisionModeCount; ++m) {
+        const VisionMode mode = static_cast<VisionMode>(m);
+        std::vector<qint64> ns;
+        for (int i = 0; i < iterations; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            applyVisionFilter(screenshot, filtered, mode);
+            ns.push_back(timer.nsecsElapsed());
+        }
+        applyVisionFilterReference(screenshot, reference, mode);
+        int differing = 0;
+        for (int y = 0; y < screenshot.height(); ++y) {
+            if (memcmp(filtered.constScanLine(y), reference.constScanLine(y), size_t(screenshot.width()) * 4)) {
+                ++differing;
+            }
+        }
+        *mismatches += differing;
+
+        QJsonObject result = timings(ns);
+        result["resolution"] = resolution.name;
+        result["mode"] = visionModeName(mode);
+        result["mismatched_rows"] = differing;
+        results.append(result);
+    }
+    return results;
+}
+
+// Session snapshots: encoding the capture, and decoding it back into a
+// reused buffer the way a reopen does, checked against the original. One PNG
+// encode of the same capture for scale.
+QJsonArray benchSnapshot(const Resolution& resolution, const QImage& screenshot, int iterations, int* mismatches) {
+    QJsonArray results;
+    QByteArray encoded;
+    std::vector<qint64> encodeNs;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        encodeSnapshot(screenshot, &encoded);
+        encodeNs.push_back(timer.nsecsElapsed());
+    }
+    QImage decoded;
+    std::vector<qint64> decodeNs;
+    bool ok = true;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        ok = decodeSnapshot(reinterpret_cast<const uchar*>(encoded.constData()), encoded.size(), decoded) && ok;
+        decodeNs.push_back(timer.nsecsElapsed());
+    }
+    int differing = 0;
+    for (int y = 0; y < screenshot.height(); ++y) {
+        if (!ok || memcmp(decoded.constScanLine(y), screenshot.constScanLine(y), size_t(screenshot.width()) * 4)) {
+            ++differing;
+        }
+    }
+    *mismatches += differing;
+
+    QByteArray png;
+    QBuffer pngBuffer(&png);
+    pngBuffer.open(QIODevice::WriteOnly);
+    QElapsedTimer pngTimer;
+    pngTimer.start();
+    screenshot.save(&pngBuffer, "PNG");
+    const double pngMs = pngTimer.nsecsElapsed() / 1e6;
+
+    const double rawBytes = double(screenshot.width()) * screenshot.height() * 4;
+    QJsonObject encode = timings(encodeNs);
+    encode["resolution"] = resolution.name;
+    encode["mode"] = "encode";
+    encode["ratio"] = rawBytes / encoded.size();
+    encode["png_ms"] = pngMs;
+    encode["png_ratio"] = rawBytes / png.size();
+    results.append(encode);
+    QJsonObject decode = timings(decodeNs);
+    decode["resolution"] = resolution.name;
+    decode["mode"] = "decode";
+    decode["mismatched_rows"] = differing;
+    results.append(decode);
+    return results;
+}
+
+// Palette of a whole-screen selection: the subsampled live preview that runs
+// while dragging, and the full-resolution pass on release.
+QJsonArray benchPalette(const Resolution& resolution, const QImage& screenshot, int iterations) {
+    QJsonArray results;
+    PixelSampler sampler(screenshot);
+    const QRect region = screenshot.rect();
+    for (int count : {5, 16}) {
+        for (bool preview : {true, false}) {
+            const int step = preview ? paletteStep(region) : 1;
+            std::vector<qint64> ns;
+            for (int i = 0; i < iterations; ++i) {
+                QElapsedTimer timer;
+                timer.start();
+                std::vector<PaletteColor> palette = extractPalette(sampler, region, count, step);
+                ns.push_back(timer.nsecsElapsed());
+                sink = sink + quint32(palette.size());
+            }
+            QJsonObject result = timings(ns);
+            result["resolution"] = resolution.name;
+            result["colors"] = count;
+            result["mode"] = preview ? "preview" : "full";
+            result["step"] = step;
+            results.append(result);
+        }
+    }
+    return results;
+}
+
+// Nearest-name lookups in a 30k entry palette, random colors and a slow walk
+// like the magnifier produces, checked against a linear scan.
+QJsonObject benchNamedColors(int queries, int* mismatches) {
+    Random random(12345);
+    std::vector<NamedColor> colors;
+    for (int i = 0; i < 30000; ++i) colors.push_back({QString("color %1").arg(i), random.next() & 0xffffff});
+    std::vector<std::array<float, 3>> labs(colors.size());
+    for (size_t i = 0; i < colors.size(); ++i) {
+        const QRgb c = colors[i].color;
+        ColorFormatter::instance().toOklab(qRed(c), qGreen(c), qBlue(c), labs[i].data());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    NamedColorIndex index(colors);
+    QJsonObject result;
+    result["entries"] = index.size();
+    result["build_ms"] = timer.nsecsElapsed() / 1e6;
+
+    std::vector<QRgb> randomColors(queries);
+    for (QRgb& c : randomColors) c = random.next() & 0xffffff;
+    timer.restart();
+    int acc = 0;
+    for (QRgb c : randomColors) acc += index.nearest(c);
+    result["random_ns_per_query"] = double(timer.nsecsElapsed()) / queries;
+
+    QRgb c = 0x336699;
+    timer.restart();
+    for (int i = 0; i < queries; ++i) {
+        c = (c + (i & 1 ? 0x010101u : 0x000100u)) & 0xffffff;
+        acc += index.nearest(c);
+    }
+    result["walk_ns_per_query"] = double(timer.nsecsElapsed()) / queries;
+    sink = sink + quint32(acc);
+
+    // ties may resolve to another entry, so compare distances
+    const int checked = std::min(queries, 10000);
+    for (int i = 0; i < checked; ++i) {
+        float lab[3];
+        ColorFormatter::instance().toOklab(qRed(randomColors[i]), qGreen(randomColors[i]), qBlue(randomColors[i]), lab);
+        float best = std::numeric_limits<float>::max();
+        for (const auto& entry : labs) {
+            const float d0 = lab[0] - entry[0], d1 = lab[1] - entry[1], d2 = lab[2] - entry[2];
+            best = std::min(best, d0 * d0 + d1 * d1 + d2 * d2);
+        }
+        float distance = 0;
+        index.nearest(randomColors[i], &distance);
+        if (std::abs(distance * distance - best) > 1e-9f) ++*mismatches;
+    }
+    result["checked"] = checked;
+    return result;
+}
+
+// Formatter throughput per format, plus a byte-for-byte comparison with the
+// reference formatter (random colors, or every color with --verify-all).
+QJsonArray benchFormats(int calls, bool verifyAll, int* mismatches) {
+    QJsonArray results;
+    const ColorFormatter& formatter = ColorFormatter::instance();
+    Random random;
+    std::vector<QRgb> colors(calls);
+    for (QRgb& c : colors) c = random.next();
+
+    for (const FormatName& entry : kFormats) {
+        QJsonObject result;
+        result["format"] = entry.name;
+        char buffer[ColorFormatter::kMaxLength];
+
+        QElapsedTimer timer;
+        timer.start();
+        quint32 acc = 0;
+        for (QRgb c : colors) acc += quint32(formatter.format(c, entry.format, buffer));
+        result["buffer_ns_per_call"] = double(timer.nsecsElapsed()) / calls;
+
+        timer.restart();
+        for (QRgb c : colors) acc += quint32(formatColor(QColor::fromRgba(c), entry.format).size());
+        result["qstring_ns_per_call"] = double(timer.nsecsElapsed()) / calls;
+
+        if (entry.hasReference) {
+            timer.restart();
+            for (QRgb c : colors) acc += quint32(formatColorReference(QColor::fromRgba(c), entry.format).size());
+            result["reference_ns_per_call"] = double(timer.nsecsElapsed()) / calls;
+
+            qint64 checked = 0;
+            int wrong = 0;
+            auto check = [&](QRgb c) {
+                const QColor color = QColor::fromRgba(c);
+                if (formatColor(color, entry.format) != formatColorReference(color, entry.format)) {
+                    if (wrong < 5) {
+                        std::fprintf(stderr, "format %s mismatch for #%08x: \"%s\" vs \"%s\"\n", entry.name, c,
+                                     qPrintable(formatColor(color, entry.format)),
+                                     qPrintable(formatColorReference(color, entry.format)));
+                    }
+                    ++wrong;
+                }
+                ++checked;
+            };
+            if (verifyAll) {
+                // alpha only shows up in rgba, the other formats ignore it
+                for (quint32 rgb = 0; rgb < 0x1000000; ++rgb) check(0xff000000 | rgb);
+                if (entry.format == ColorFormat::RGBA) {
+                    for (quint32 a = 0; a < 256; ++a) check((a << 24) | 0x808080);
+                }
+            } else {
+                for (QRgb c : colors) check(c);
+            }
+            result["checked"] = checked;
+            result["mismatches"] = wrong;
+            *mismatches += wrong;
+        }
+        sink = sink + acc;
+        results.append(result);
+    }
+    return results;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Color picker benchmarks, results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption outputOption("output", "Write the JSON to <file> instead of stdout.", "file");
+    QCommandLineOption quickOption("quick", "Fewer iterations, for a smoke test.");
+    QCommandLineOption resolutionsOption("resolutions", "Comma separated subset of 1080p, 4k, 8k.", "list",
+                                         "1080p,4k,8k");
+    QCommandLineOption verifyAllOption("verify-all",
+                                       "Compare formatColor() with the reference for every color (slow).");
+    parser.addOption(outputOption);
+    parser.addOption(quickOption);
+    parser.addOption(resolutionsOption);
+    parser.addOption(verifyAllOption);
+    parser.process(app);
+
+    const bool quick = parser.isSet(quickOption);
+    const QStringList wanted = parser.value(resolutionsOption).toLower().split(',', Qt::SkipEmptyParts);
+
+    QJsonObject report;
+    report["qt"] = qVersion();
+    report["platform"] = QGuiApplication::platformName();
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    report["avx2"] = bool(__builtin_cpu_supports("avx2"));
+#endif
+
+    QJsonArray firstFrame;
+    QJsonArray frames;
+    QJsonArray sampling;
+    QJsonArray palette;
+    QJsonArray vision;
+    int visionMismatches = 0;
+    QJsonArray snapshot;
+    int snapshotMismatches = 0;
+    for (const Resolution& resolution : kResolutions) {
+        if (!wanted.contains(resolution.name)) continue;
+        const QImage screenshot = syntheticScreenshot(resolution.size);
+
+        SyntheticCaptureBackend synthetic(screenshot);
+        firstFrame.append(benchFirstFrame(&synthetic, QRect(QPoint(0, 0), resolution.size), quick ? 3 : 20));
+        // the default magnifier, then large ones at low and high zoom
+        for (const QPoint& magnifier : {QPoint(12, 150), QPoint(2, 800), QPoint(32, 800)}) {
+            frames.append(benchFrames(resolution, screenshot, quick ? 120 : 1000, magnifier.x(), magnifier.y()));
+        }
+        for (const QJsonValue& value : benchSampling(resolution, screenshot, quick ? 100000 : 1000000)) {
+            sampling.append(value);
+        }
+        for (const QJsonValue& value : benchPalette(resolution, screenshot, quick ? 3 : 20)) {
+            palette.append(value);
+        }
+        for (const QJsonValue& value : benchVisionFilter(resolution, screenshot, quick ? 3 : 20, &visionMismatches)) {
+            vision.append(value);
+        }
+        for (const QJsonValue& value : benchSnapshot(resolution, screenshot, quick ? 3 : 20, &snapshotMismatches)) {
+            snapshot.append(value);
+        }
+    }
+
+    // the real backends on whatever screens this platform reports
+    CaptureBackendList backends = createCaptureBackends();
+    const QRect desktop = virtualDesktopGeometry();
+    QJsonArray liveCapture;
+    QJsonArray watchGrab;
+    for (const auto& backend : backends) {
+        if (!backend->isAvailable() || desktop.isEmpty()) continue;
+        firstFrame.append(benchFirstFrame(backend.get(), desktop, quick ? 2 : 5));
+        for (const QJsonValue& value : benchLiveCapture(backend.get(), desktop, quick ? 20 : 300)) {
+            liveCapture.append(value);
+        }
+        for (const QJsonValue& value : benchWatchGrab(backend.get(), desktop, quick ? 20 : 300)) {
+            watchGrab.append(value);
+        }
+    }
+
+    int mismatches = 0;
+    report["capture_to_first_frame"] = firstFrame;
+    report["frame_time"] = frames;
+    report["live_capture"] = liveCapture;
+    report["watch_grab"] = watchGrab;
+    report["sampling"] = sampling;
+    report["palette"] = palette;
+    report["vision_filter"] = vision;
+    report["vision_filter_mismatches"] = visionMismatches;
+    report["snapshot"] = snapshot;
+    report["snapshot_mismatches"] = snapshotMismatches;
+    report["format"] = benchFormats(quick ? 20000 : 200000, parser.isSet(verifyAllOption), &mismatches);
+    report["format_mismatches"] = mismatches;
+    int namedMismatches = 0;
+    report["named_color"] = benchNamedColors(quick ? 100000 : 1000000, &namedMismatches);
+    report["named_color_mismatches"] = namedMismatches;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outputOption)));
+            return 2;
+        }
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return mismatches == 0 && namedMismatches == 0 && visionMismatches == 0 && snapshotMismatches == 0 ? 0 : 1;
+}
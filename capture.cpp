@@ -0,0 +1,417 @@
+#include "capture.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QPainter>
+#include <QPixmap>
+#include <QProcess>
+#include <QScreen>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+#include "trace.h"
+
+#ifdef COLORPICKER_HAVE_XCB_SHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <xcb/shm.h>
+#include <xcb/xcb.h>
+#include <cstdlib>
+#endif
+
+#ifdef COLORPICKER_HAVE_XCB_DAMAGE
+#include <xcb/damage.h>
+#include <xcb/xcb.h>
+#include <cstdlib>
+#endif
+
+void ensureCaptureBuffer(QImage& buffer, const QSize& size) {
+    if (buffer.size() != size || buffer.format() != QImage::Format_RGB32) {
+        buffer = QImage(size, QImage::Format_RGB32);
+    }
+}
+
+QImage captureView(const QImage& buffer, const QRect& rect) {
+    QRect valid = rect.intersected(buffer.rect());
+    if (valid.isEmpty()) return QImage();
+    const uchar* origin = buffer.constBits() + valid.y() * buffer.bytesPerLine() + qsizetype(valid.x()) * 4;
+    return QImage(origin, valid.width(), valid.height(), buffer.bytesPerLine(), QImage::Format_RGB32);
+}
+
+// in-process grab through the Qt platform plugin (X11, Xvfb, offscreen)
+class GrabWindowCaptureBackend : public CaptureBackend {
+   public:
+    QString name() const override { return "grabwindow"; }
+
+    // QScreen/QPixmap are GUI-thread only
+    bool requiresGuiThread() const override { return true; }
+
+    bool isAvailable() const override {
+        // compositor-side capture only, Qt cannot read other clients' pixels on wayland
+        return !QGuiApplication::platformName().startsWith("wayland");
+    }
+
+    bool capture(const QRect& virtualGeometry, QImage& buffer) override {
+        const QList<QScreen*> screens = QGuiApplication::screens();
+        if (screens.size() == 1 && screens.first()->geometry() == virtualGeometry) {
+            TraceSpan span("grabWindow");
+            buffer = screens.first()->grabWindow(0).toImage().convertToFormat(QImage::Format_RGB32);
+            return !buffer.isNull();
+        }
+
+        ensureCaptureBuffer(buffer, virtualGeometry.size());
+        buffer.fill(Qt::black);
+        QPainter painter(&buffer);
+        for (QScreen* screen : screens) {
+            TraceSpan span("grabWindow");
+            span.setDetail(screen->name());
+            QPixmap grab = screen->grabWindow(0);
+            if (grab.isNull()) return false;
+            QRect target = screen->geometry().translated(-virtualGeometry.topLeft());
+            painter.drawPixmap(target, grab);
+        }
+        painter.end();
+        return true;
+    }
+
+    bool captureRegion(const QRect& rect, QImage& buffer) override {
+        QScreen* screen = QGuiApplication::screenAt(rect.center());
+        if (!screen) return false;
+
+        // grabWindow takes coordinates relative to the screen; the part of rect
+        // on other screens stays black, the magnifier only needs the centre
+        const QRect geometry = screen->geometry();
+        const QRect valid = rect.intersected(geometry);
+        QImage grab = screen->grabWindow(0, valid.x() - geometry.x(), valid.y() - geometry.y(),
+                                         valid.width(), valid.height())
+                          .toImage();
+        if (grab.isNull()) return false;
+
+        ensureCaptureBuffer(buffer, rect.size());
+        if (valid != rect) buffer.fill(Qt::black);
+        QPainter painter(&buffer);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(valid.topLeft() - rect.topLeft(), grab);
+        return true;
+    }
+};
+
+#ifdef COLORPICKER_HAVE_XCB_SHM
+// X11 MIT-SHM: the server writes the root window straight into shared memory
+class XShmCaptureBackend : public CaptureBackend {
+   public:
+    XShmCaptureBackend() : usable_(connect()) {}
+
+    ~XShmCaptureBackend() override {
+        releaseSegment();
+        if (connection_) xcb_disconnect(connection_);
+    }
+
+    QString name() const override { return "xshm"; }
+
+    bool isAvailable() const override {
+        // xwayland would only show X clients, so require a real X11 session
+        return usable_ && QGuiApplication::platformName() == "xcb";
+    }
+
+    // A desktop-sized segment is not kept: between picks it would be a second
+    // capture buffer resident for the life of the process
+    bool capture(const QRect& virtualGeometry, QImage& buffer) override {
+        const bool ok = grab(virtualGeometry, buffer);
+        releaseSegment();
+        return ok;
+    }
+
+    // same path; the segment only has to hold the small rect and is kept for
+    // the next frame of a live pick or watch
+    bool captureRegion(const QRect& rect, QImage& buffer) override {
+        return grab(rect, buffer);
+    }
+
+   private:
+    bool grab(const QRect& rect, QImage& buffer) {
+        if (!usable_) return false;
+
+        // the server rejects requests reaching past the root window
+        const QRect valid = rect.intersected(rootGeometry_);
+        if (valid.isEmpty()) return false;
+
+        const size_t bytes = size_t(valid.width()) * valid.height() * 4;
+        if (!ensureSegment(bytes)) return false;
+
+        TraceSpan getImage("xcb_shm_get_image");
+        xcb_shm_get_image_cookie_t cookie = xcb_shm_get_image(
+            connection_, root_,
+            valid.x(), valid.y(),
+            valid.width(), valid.height(),
+            ~0u, XCB_IMAGE_FORMAT_Z_PIXMAP, segment_, 0);
+        xcb_generic_error_t* error = nullptr;
+        xcb_shm_get_image_reply_t* reply = xcb_shm_get_image_reply(connection_, cookie, &error);
+        if (!reply) {
+            free(error);
+            return false;
+        }
+        free(reply);
+
+        // the segment is reused by the next capture, so hand over a copy of the raw rows
+        TraceSpan copy("copy segment");
+        ensureCaptureBuffer(buffer, rect.size());
+        if (valid != rect) buffer.fill(Qt::black);
+        const uchar* src = static_cast<const uchar*>(shmAddr_);
+        const qsizetype rowBytes = qsizetype(valid.width()) * 4;
+        const QPoint offset = valid.topLeft() - rect.topLeft();
+        for (int y = 0; y < valid.height(); ++y) {
+            // the pad byte of a BGRX pixel is undefined, RGB32 wants it 0xff
+            const QRgb* in = reinterpret_cast<const QRgb*>(src + y * rowBytes);
+            QRgb* out = reinterpret_cast<QRgb*>(buffer.scanLine(offset.y() + y)) + offset.x();
+            for (int x = 0; x < valid.width(); ++x) out[x] = in[x] | 0xff000000;
+        }
+        return true;
+    }
+
+    bool connect() {
+        connection_ = xcb_connect(nullptr, nullptr);
+        if (xcb_connection_has_error(connection_)) return false;
+
+        xcb_shm_query_version_reply_t* version =
+            xcb_shm_query_version_reply(connection_, xcb_shm_query_version(connection_), nullptr);
+        if (!version) return false;
+        free(version);
+
+        xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(connection_)).data;
+        // ZPixmap at depth 24/32 is 32bpp BGRX, the same layout as QImage::Format_RGB32
+        if (!screen || (screen->root_depth != 24 && screen->root_depth != 32)) return false;
+        root_ = screen->root;
+        rootGeometry_ = QRect(0, 0, screen->width_in_pixels, screen->height_in_pixels);
+        return true;
+    }
+
+    bool ensureSegment(size_t bytes) {
+        if (shmAddr_ && shmSize_ >= bytes) return true;
+        releaseSegment();
+
+        int id = shmget(IPC_PRIVATE, bytes, IPC_CREAT | 0600);
+        if (id < 0) return false;
+        void* addr = shmat(id, nullptr, 0);
+        if (addr == reinterpret_cast<void*>(-1)) {
+            shmctl(id, IPC_RMID, nullptr);
+            return false;
+        }
+
+        segment_ = xcb_generate_id(connection_);
+        xcb_generic_error_t* error = xcb_request_check(connection_, xcb_shm_attach_checked(connection_, segment_, id, 0));
+        // marked for removal now, it goes away once both sides detach
+        shmctl(id, IPC_RMID, nullptr);
+        if (error) {
+            free(error);
+            shmdt(addr);
+            return false;
+        }
+
+        shmAddr_ = addr;
+        shmSize_ = bytes;
+        return true;
+    }
+
+    void releaseSegment() {
+        if (!shmAddr_) return;
+        xcb_shm_detach(connection_, segment_);
+        xcb_flush(connection_);
+        shmdt(shmAddr_);
+        shmAddr_ = nullptr;
+        shmSize_ = 0;
+    }
+
+    xcb_connection_t* connection_ = nullptr;
+    xcb_window_t root_ = 0;
+    QRect rootGeometry_;
+    xcb_shm_seg_t segment_ = 0;
+    void* shmAddr_ = nullptr;
+    size_t shmSize_ = 0;
+    bool usable_;
+};
+#endif
+
+#ifdef COLORPICKER_HAVE_XCB_DAMAGE
+// Damage on the root window, at raw rectangle level so nothing has to be
+// subtracted: every redraw anywhere on screen arrives as one event. Runs on a
+// connection of its own, nothing else reads events from it.
+class XDamageScreenDamage : public ScreenDamage {
+   public:
+    ~XDamageScreenDamage() override {
+        if (damage_) xcb_damage_destroy(connection_, damage_);
+        if (connection_) xcb_disconnect(connection_);
+    }
+
+    bool connect() {
+        connection_ = xcb_connect(nullptr, nullptr);
+        if (xcb_connection_has_error(connection_)) return false;
+
+        const xcb_query_extension_reply_t* extension = xcb_get_extension_data(connection_, &xcb_damage_id);
+        if (!extension || !extension->present) return false;
+        firstEvent_ = extension->first_event;
+
+        // required before any other damage request
+        xcb_damage_query_version_reply_t* version = xcb_damage_query_version_reply(
+            connection_, xcb_damage_query_version(connection_, XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION),
+            nullptr);
+        if (!version) return false;
+        free(version);
+
+        xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(connection_)).data;
+        if (!screen) return false;
+        damage_ = xcb_generate_id(connection_);
+        xcb_generic_error_t* error = xcb_request_check(
+            connection_,
+            xcb_damage_create_checked(connection_, damage_, screen->root, XCB_DAMAGE_REPORT_LEVEL_RAW_RECTANGLES));
+        if (error) {
+            free(error);
+            damage_ = 0;
+            return false;
+        }
+        return true;
+    }
+
+    int socketDescriptor() const override { return xcb_get_file_descriptor(connection_); }
+
+    bool isConnected() const override { return !xcb_connection_has_error(connection_); }
+
+    bool takeDamage(const std::vector<QRect>& rects) override {
+        bool hit = false;
+        while (xcb_generic_event_t* event = xcb_poll_for_event(connection_)) {
+            if ((event->response_type & 0x7f) == firstEvent_ + XCB_DAMAGE_NOTIFY && !hit) {
+                const auto* notify = reinterpret_cast<const xcb_damage_notify_event_t*>(event);
+                const QRect area(notify->area.x, notify->area.y, notify->area.width, notify->area.height);
+                for (const QRect& rect : rects) {
+                    if (rect.intersects(area)) {
+                        hit = true;
+                        break;
+                    }
+                }
+            }
+            free(event);
+        }
+        return hit;
+    }
+
+   private:
+    xcb_connection_t* connection_ = nullptr;
+    xcb_damage_damage_t damage_ = 0;
+    uint8_t firstEvent_ = 0;
+};
+#endif
+
+// external fallback: spectacle writes a PNG which is decoded again
+class SpectacleCaptureBackend : public CaptureBackend {
+   public:
+    QString name() const override { return "spectacle"; }
+
+    bool isAvailable() const override {
+        return !QStandardPaths::findExecutable("spectacle").isEmpty();
+    }
+
+    bool capture(const QRect&, QImage& buffer) override {
+        QTemporaryDir tempDir;
+        if (!tempDir.isValid()) return false;
+
+        // get all screens
+        QString fullScreenshot = tempDir.path() + "/fullscreen.png";
+        {
+            TraceSpan span("spectacle");
+            QProcess spectacleProcess;
+            // take screenshot of all screens
+            spectacleProcess.start("spectacle", QStringList() << "-fb" << "-n" << "-o" << fullScreenshot);
+            spectacleProcess.waitForFinished(2000);
+        }
+
+        TraceSpan decode("decode png");
+        QImage fullCapture(fullScreenshot);
+        if (fullCapture.isNull()) return false;
+        buffer = fullCapture.convertToFormat(QImage::Format_RGB32);
+        return true;
+    }
+};
+
+CaptureBackendList createCaptureBackends() {
+    CaptureBackendList backends;
+#ifdef COLORPICKER_HAVE_XCB_SHM
+    backends.push_back(std::make_unique<XShmCaptureBackend>());
+#endif
+    backends.push_back(std::make_unique<GrabWindowCaptureBackend>());
+    backends.push_back(std::make_unique<SpectacleCaptureBackend>());
+    return backends;
+}
+
+std::unique_ptr<ScreenDamage> createScreenDamage() {
+#ifdef COLORPICKER_HAVE_XCB_DAMAGE
+    // under xwayland only X clients would report damage
+    if (QGuiApplication::platformName() != "xcb") return nullptr;
+    auto damage = std::make_unique<XDamageScreenDamage>();
+    if (damage->connect()) return damage;
+#endif
+    return nullptr;
+}
+
+QRect virtualDesktopGeometry() {
+    const QList<QScreen*> screens = QGuiApplication::screens();
+    if (screens.isEmpty()) return QRect();
+    QRect virtualGeo = screens.first()->geometry();
+    for (QScreen* s : screens) {
+        virtualGeo = virtualGeo.united(s->geometry());
+    }
+    return virtualGeo;
+}
+
+QList<CaptureBackend*> captureOrder(const CaptureBackendList& backends, const QString& preferred) {
+    QList<CaptureBackend*> order;
+    for (const auto& backend : backends) {
+        if (backend->name() == preferred) order.append(backend.get());
+    }
+    for (const auto& backend : backends) {
+        if (!order.contains(backend.get())) order.append(backend.get());
+    }
+    return order;
+}
+
+bool timedCapture(CaptureBackend* backend, const QRect& virtualGeo, QImage& buffer) {
+    TraceSpan span("capture");
+    span.setDetail(backend->name());
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = backend->capture(virtualGeo, buffer);
+    qInfo().noquote() << QString("capture backend %1: %2 ms%3")
+                             .arg(backend->name())
+                             .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2)
+                             .arg(ok ? "" : " (failed)");
+    return ok;
+}
+
+QImage captureVirtualDesktop(const CaptureBackendList& backends, const QString& preferred, const QRect& virtualGeo) {
+    QImage buffer;
+    for (CaptureBackend* backend : captureOrder(backends, preferred)) {
+        if (!backend->isAvailable()) continue;
+        if (timedCapture(backend, virtualGeo, buffer)) return buffer;
+    }
+    return QImage();
+}
+
+void reportMemory(const QString& label, const QImage& captureBuffer, qint64 sumTableBytes) {
+    if (!qEnvironmentVariableIsSet("COLORPICKER_MEMORY_REPORT")) return;
+
+    QString rss = "?";
+    QString peak = "?";
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        for (const QByteArray& line : status.readAll().split('\n')) {
+            if (line.startsWith("VmRSS:")) rss = QString::fromLatin1(line.mid(6).simplified());
+            if (line.startsWith("VmHWM:")) peak = QString::fromLatin1(line.mid(6).simplified());
+        }
+    }
+    qInfo().noquote() << QString("memory %1: capture buffer %2 MB, summed-area table %3 MB, rss %4, peak rss %5")
+                             .arg(label)
+                             .arg(captureBuffer.sizeInBytes() / 1048576.0, 0, 'f', 1)
+                             .arg(sumTableBytes / 1048576.0, 0, 'f', 1)
+                             .arg(rss, peak);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QString>
+#include <memory>
+#include <vector>
+
+// keeps the allocation when the buffer already fits
+void ensureCaptureBuffer(QImage& buffer, const QSize& size);
+
+// Non-owning RGB32 view of rect inside buffer: same memory, same stride, no copy.
+// The buffer must outlive the view.
+QImage captureView(const QImage& buffer, const QRect& rect);
+
+// Screen capture backends. Each one fills buffer with the whole virtual
+// desktop as a single RGB32 image, origin at virtualGeometry.topLeft().
+// The buffer is written in place when it already has that size and format.
+class CaptureBackend {
+   public:
+    virtual ~CaptureBackend() = default;
+
+    virtual QString name() const = 0;
+    virtual bool isAvailable() const = 0;
+    virtual bool capture(const QRect& virtualGeometry, QImage& buffer) = 0;
+
+    // Only rect (virtual desktop coordinates) into a buffer of rect's size,
+    // black where no screen is, for live sampling at display refresh rate.
+    // Backends that can only capture everything return false.
+    virtual bool captureRegion(const QRect& rect, QImage& buffer) {
+        Q_UNUSED(rect);
+        Q_UNUSED(buffer);
+        return false;
+    }
+
+    // backends that are not thread-safe are run on the GUI thread, all others in the pool
+    virtual bool requiresGuiThread() const { return false; }
+};
+
+using CaptureBackendList = std::vector<std::unique_ptr<CaptureBackend>>;
+
+// Which parts of the screen were redrawn, so watchers can skip grabbing
+// pixels that cannot have changed. X11 only, through the Damage extension.
+class ScreenDamage {
+   public:
+    virtual ~ScreenDamage() = default;
+
+    // turns readable when damage events arrive, for a QSocketNotifier
+    virtual int socketDescriptor() const = 0;
+
+    // false once the display connection broke, no more events will come
+    virtual bool isConnected() const = 0;
+
+    // drains the pending events; true when any damaged area meets one of rects
+    // (virtual desktop coordinates)
+    virtual bool takeDamage(const std::vector<QRect>& rects) = 0;
+};
+
+// null when the session is not X11 or the server lacks the extension
+std::unique_ptr<ScreenDamage> createScreenDamage();
+
+// in auto-selection order, in-process backends first
+CaptureBackendList createCaptureBackends();
+
+QRect virtualDesktopGeometry();
+
+// preferred backend first, then the rest in auto-selection order
+QList<CaptureBackend*> captureOrder(const CaptureBackendList& backends, const QString& preferred);
+
+// one capture attempt, logging the latency of the backend
+bool timedCapture(CaptureBackend* backend, const QRect& virtualGeo, QImage& buffer);
+
+// blocking variant for one-shot use outside the tray app
+QImage captureVirtualDesktop(const CaptureBackendList& backends, const QString& preferred, const QRect& virtualGeo);
+
+// resident and peak memory of the process, enable with COLORPICKER_MEMORY_REPORT=1
+void reportMemory(const QString& label, const QImage& captureBuffer, qint64 sumTableBytes = 0);
@@ -0,0 +1,98 @@
+#include "colorformat.h"
+
+#include <QMap>
+
+QString formatColorReference(const QColor& color, ColorFormat format) {
+    switch (format) {
+        case ColorFormat::HTML:
+            return color.name().toUpper().mid(1);  // Remove #
+        case ColorFormat::HEX:
+            return color.name().toUpper();
+        case ColorFormat::DelphiHex:
+            return QString("$00%1%2%3")
+                .arg(color.blue(), 2, 16, QChar('0'))
+                .arg(color.green(), 2, 16, QChar('0'))
+                .arg(color.red(), 2, 16, QChar('0'))
+                .toUpper();
+        case ColorFormat::VBHex:
+            return QString("&H00%1%2%3&")
+                .arg(color.blue(), 2, 16, QChar('0'))
+                .arg(color.green(), 2, 16, QChar('0'))
+                .arg(color.red(), 2, 16, QChar('0'))
+                .toUpper();
+        case ColorFormat::RGBA:
+            return QString("rgba(%1, %2, %3, %4)")
+                .arg(color.red())
+                .arg(color.green())
+                .arg(color.blue())
+                .arg(color.alphaF(), 0, 'f', 2);
+        case ColorFormat::RGB:
+            return QString("rgb(%1, %2, %3)")
+                .arg(color.red())
+                .arg(color.green())
+                .arg(color.blue());
+        case ColorFormat::RGBFloat:
+            return QString("%1, %2, %3")
+                .arg(color.redF(), 0, 'f', 3)
+                .arg(color.greenF(), 0, 'f', 3)
+                .arg(color.blueF(), 0, 'f', 3);
+        case ColorFormat::HSV:
+            return QString("hsv(%1, %2%, %3%)")
+                .arg(color.hsvHue())
+                .arg(color.hsvSaturation() * 100 / 255)
+                .arg(color.value() * 100 / 255);
+        case ColorFormat::HSL:
+            return QString("hsl(%1, %2%, %3%)")
+                .arg(color.hslHue())
+                .arg(color.hslSaturation() * 100 / 255)
+                .arg(color.lightness() * 100 / 255);
+        case ColorFormat::Lab:
+        case ColorFormat::OKLab:
+        case ColorFormat::OKLCH:
+        case ColorFormat::CMYK:
+            break;  // newer than the reference
+    }
+    return color.name().toUpper().mid(1);
+}
+
+QString formatColor(const QColor& color, ColorFormat format) {
+    char buffer[ColorFormatter::kMaxLength];
+    const int length = ColorFormatter::instance().format(color.rgba(), format, buffer);
+    return QString::fromLatin1(buffer, length);
+}
+
+namespace {
+
+// names used on the command line
+const QMap<QString, ColorFormat>& colorFormatNames() {
+    static const QMap<QString, ColorFormat> formats = {
+        {"html", ColorFormat::HTML},
+        {"hex", ColorFormat::HEX},
+        {"delphi", ColorFormat::DelphiHex},
+        {"vb", ColorFormat::VBHex},
+        {"rgba", ColorFormat::RGBA},
+        {"rgb", ColorFormat::RGB},
+        {"rgbf", ColorFormat::RGBFloat},
+        {"hsv", ColorFormat::HSV},
+        {"hsl", ColorFormat::HSL},
+        {"lab", ColorFormat::Lab},
+        {"oklab", ColorFormat::OKLab},
+        {"oklch", ColorFormat::OKLCH},
+        {"cmyk", ColorFormat::CMYK},
+    };
+    return formats;
+}
+
+}  // namespace
+
+bool parseColorFormat(const QString& name, ColorFormat* format) {
+    const QMap<QString, ColorFormat>& formats = colorFormatNames();
+    auto it = formats.constFind(name.toLower());
+    if (it == formats.constEnd()) return false;
+    *format = it.value();
+    return true;
+}
+
+QString colorFormatName(ColorFormat format) {
+    return colorFormatNames().key(format);
+}
@@ -0,0 +1,384 @@
+#pragma once
+
+#include <QByteArray>
+#include <QColor>
+#include <QDebug>
+#include <QString>
+#include <cmath>
+#include <cstring>
+
+enum class ColorFormat {
+    HTML,       // RRGGBB (hex without #)
+    HEX,        // #RRGGBB
+    DelphiHex,  // $00BBGGRR
+    VBHex,      // &H00BBGGRR&
+    RGBA,       // rgba(r, g, b, a)
+    RGB,        // rgb(r, g, b)
+    RGBFloat,   // r.rrr, g.ggg, b.bbb
+    HSV,        // hsv(h, s%, v%)
+    HSL,        // hsl(h, s%, l%)
+    Lab,        // lab(L a b), CIELAB D65
+    OKLab,      // oklab(L a b)
+    OKLCH,      // oklch(L C h)
+    CMYK        // cmyk(c%, m%, y%, k%)
+};
+
+// The original QString::arg() based formatter. ColorFormatter must reproduce
+// it byte for byte for the first nine formats, so it is kept as the reference.
+QString formatColorReference(const QColor& color, ColorFormat format);
+
+// Table-driven color formatting. Writes into a caller buffer of kMaxLength
+// chars without allocating: hex pairs, the float strings QColor would print and
+// sRGB -> linear values are tabulated once, HSV/HSL follow QColor's own 16-bit
+// channel math so the result matches formatColorReference().
+class ColorFormatter {
+   public:
+    static constexpr int kMaxLength = 48;
+
+    static const ColorFormatter& instance() {
+        static const ColorFormatter formatter;
+        return formatter;
+    }
+
+    // returns the number of chars written, no terminator
+    int format(QRgb rgba, ColorFormat format, char* out) const {
+        const int r = qRed(rgba);
+        const int g = qGreen(rgba);
+        const int b = qBlue(rgba);
+        char* p = out;
+
+        switch (format) {
+            case ColorFormat::HTML:
+                p = hex(p, r, g, b);
+                break;
+            case ColorFormat::HEX:
+                *p++ = '#';
+                p = hex(p, r, g, b);
+                break;
+            case ColorFormat::DelphiHex:
+                p = text(p, "$00");
+                p = hex(p, b, g, r);
+                break;
+            case ColorFormat::VBHex:
+                p = text(p, "&H00");
+                p = hex(p, b, g, r);
+                *p++ = '&';
+                break;
+            case ColorFormat::RGBA:
+                p = text(p, "rgba(");
+                p = decimals(p, r, g, b);
+                p = text(p, ", ");
+                p = text(p, alpha2_[qAlpha(rgba)]);
+                *p++ = ')';
+                break;
+            case ColorFormat::RGB:
+                p = text(p, "rgb(");
+                p = decimals(p, r, g, b);
+                *p++ = ')';
+                break;
+            case ColorFormat::RGBFloat:
+                p = text(p, unit3_[r]);
+                p = text(p, ", ");
+                p = text(p, unit3_[g]);
+                p = text(p, ", ");
+                p = text(p, unit3_[b]);
+                break;
+            case ColorFormat::HSV: {
+                int hue, saturation, value;
+                hsv(rgba, &hue, &saturation, &value);
+                p = text(p, "hsv(");
+                p = percentages(p, hue, saturation, value);
+                break;
+            }
+            case ColorFormat::HSL: {
+                int hue, saturation, lightness;
+                hsl(rgba, &hue, &saturation, &lightness);
+                p = text(p, "hsl(");
+                p = percentages(p, hue, saturation, lightness);
+                break;
+            }
+            case ColorFormat::Lab: {
+                float lab[3];
+                toLab(r, g, b, lab);
+                p = text(p, "lab(");
+                p = fixed(p, lab[0], 2);
+                *p++ = ' ';
+                p = fixed(p, lab[1], 2);
+                *p++ = ' ';
+                p = fixed(p, lab[2], 2);
+                *p++ = ')';
+                break;
+            }
+            case ColorFormat::OKLab: {
+                float lab[3];
+                toOklab(r, g, b, lab);
+                p = text(p, "oklab(");
+                p = fixed(p, lab[0], 4);
+                *p++ = ' ';
+                p = fixed(p, lab[1], 4);
+                *p++ = ' ';
+                p = fixed(p, lab[2], 4);
+                *p++ = ')';
+                break;
+            }
+            case ColorFormat::OKLCH: {
+                float lab[3];
+                toOklab(r, g, b, lab);
+                const float chroma = std::sqrt(lab[1] * lab[1] + lab[2] * lab[2]);
+                float hue = 0.0f;
+                // greys only differ from zero chroma by rounding noise, keep their hue at 0
+                if (chroma >= 0.00005f) {
+                    hue = std::atan2(lab[2], lab[1]) * 57.29577951f;
+                    if (hue < 0.0f) hue += 360.0f;
+                }
+                p = text(p, "oklch(");
+                p = fixed(p, lab[0], 4);
+                *p++ = ' ';
+                p = fixed(p, chroma, 4);
+                *p++ = ' ';
+                p = fixed(p, hue, 2);
+                *p++ = ')';
+                break;
+            }
+            case ColorFormat::CMYK: {
+                // naive device-independent conversion, percentages rounded to nearest
+                const int max = qMax(r, qMax(g, b));
+                int c = 0, m = 0, y = 0;
+                if (max > 0) {
+                    c = (200 * (max - r) + max) / (2 * max);
+                    m = (200 * (max - g) + max) / (2 * max);
+                    y = (200 * (max - b) + max) / (2 * max);
+                }
+                const int k = (200 * (255 - max) + 255) / 510;
+                p = text(p, "cmyk(");
+                p = decimal(p, c);
+                p = text(p, "%, ");
+                p = decimal(p, m);
+                p = text(p, "%, ");
+                p = decimal(p, y);
+                p = text(p, "%, ");
+                p = decimal(p, k);
+                p = text(p, "%)");
+                break;
+            }
+        }
+        return int(p - out);
+    }
+
+    // hsvHue(), hsvSaturation(), value()
+    void hsv(QRgb rgb, int* hue, int* saturation, int* value) const {
+        if (!exactHsl_) {
+            QColor color = QColor::fromRgb(rgb);
+            *hue = color.hsvHue();
+            *saturation = color.hsvSaturation();
+            *value = color.value();
+            return;
+        }
+        const int r = qRed(rgb) * 0x101, g = qGreen(rgb) * 0x101, b = qBlue(rgb) * 0x101;
+        const int max = qMax(r, qMax(g, b));
+        const int delta = max - qMin(r, qMin(g, b));
+        *value = div257(max);
+        if (delta == 0) {
+            *hue = -1;
+            *saturation = 0;
+            return;
+        }
+        *saturation = div257(int(float(delta) / float(max) * 65535.0f + 0.5f));
+        *hue = hue100(r, g, b, max, delta) / 100;
+    }
+
+    // hslHue(), hslSaturation(), lightness()
+    void hsl(QRgb rgb, int* hue, int* saturation, int* lightness) const {
+        if (!exactHsl_) {
+            QColor color = QColor::fromRgb(rgb);
+            *hue = color.hslHue();
+            *saturation = color.hslSaturation();
+            *lightness = color.lightness();
+            return;
+        }
+        const int r = qRed(rgb) * 0x101, g = qGreen(rgb) * 0x101, b = qBlue(rgb) * 0x101;
+        const int max = qMax(r, qMax(g, b));
+        const int min = qMin(r, qMin(g, b));
+        const int delta = max - min;
+        const float light = float(max + min) * 0.5f;
+        *lightness = div257(int(light + 0.5f));
+        if (delta == 0) {
+            *hue = -1;
+            *saturation = 0;
+            return;
+        }
+        *saturation = div257(int(float(delta) * 0.5f / qMin(65535.0f - light, light) * 65535.0f + 0.5f));
+        *hue = hue100(r, g, b, max, delta) / 100;
+    }
+
+    // CIE L*a*b*, D65 white point
+    void toLab(int r, int g, int b, float* lab) const {
+        const float lr = linear_[r], lg = linear_[g], lb = linear_[b];
+        const float x = (0.4124564f * lr + 0.3575761f * lg + 0.1804375f * lb) * (1.0f / 0.95047f);
+        const float y = 0.2126729f * lr + 0.7151522f * lg + 0.0721750f * lb;
+        const float z = (0.0193339f * lr + 0.1191920f * lg + 0.9503041f * lb) * (1.0f / 1.08883f);
+        const float fx = labCurve(x), fy = labCurve(y), fz = labCurve(z);
+        lab[0] = 116.0f * fy - 16.0f;
+        lab[1] = 500.0f * (fx - fy);
+        lab[2] = 200.0f * (fy - fz);
+    }
+
+    // OKLab, straight-line matrix math so batch callers can vectorise it
+    void toOklab(int r, int g, int b, float* lab) const {
+        const float lr = linear_[r], lg = linear_[g], lb = linear_[b];
+        const float l = std::cbrt(0.4122214708f * lr + 0.5363325363f * lg + 0.0514459929f * lb);
+        const float m = std::cbrt(0.2119034982f * lr + 0.6806995451f * lg + 0.1073969566f * lb);
+        const float s = std::cbrt(0.0883024619f * lr + 0.2817188376f * lg + 0.6299787005f * lb);
+        lab[0] = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s;
+        lab[1] = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s;
+        lab[2] = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s;
+    }
+
+   private:
+    ColorFormatter() {
+        static const char digits[] = "0123456789ABCDEF";
+        for (int i = 0; i < 256; ++i) {
+            hex_[i][0] = digits[i >> 4];
+            hex_[i][1] = digits[i & 15];
+
+            // the exact strings QString::arg() makes of redF()/alphaF()
+            copyLatin1(unit3_[i], QString::number(QColor(i, 0, 0).redF(), 'f', 3));
+            copyLatin1(alpha2_[i], QString::number(QColor(0, 0, 0, i).alphaF(), 'f', 2));
+
+            const float c = i / 255.0f;
+            linear_[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        // the HSV/HSL emulation follows QColor's 16-bit channel math, older Qt
+        // releases rounded differently, so check against the linked QColor
+        // with colors that sit on rounding edges and fall back to it on mismatch
+        static const QRgb probes[] = {0x09091e, 0x30307d, 0x6060ad, 0x123456, 0xff8000,
+                                      0x7f7f80, 0x010203, 0xfe01fe, 0x00ff01, 0x808081};
+        exactHsl_ = true;
+        for (QRgb probe : probes) {
+            QColor color = QColor::fromRgb(probe);
+            int hsvValues[3], hslValues[3];
+            hsv(probe, &hsvValues[0], &hsvValues[1], &hsvValues[2]);
+            hsl(probe, &hslValues[0], &hslValues[1], &hslValues[2]);
+            if (hsvValues[0] != color.hsvHue() || hsvValues[1] != color.hsvSaturation() ||
+                hsvValues[2] != color.value() || hslValues[0] != color.hslHue() ||
+                hslValues[1] != color.hslSaturation() || hslValues[2] != color.lightness()) {
+                qWarning() << "ColorFormatter: HSV/HSL emulation differs from QColor, using QColor";
+                exactHsl_ = false;
+                break;
+            }
+        }
+    }
+
+    // qt_div_257()
+    static int div257(int x) {
+        x += 0x80;
+        return (x - (x >> 8)) >> 8;
+    }
+
+    // hue in hundredths of a degree, as QColor stores it
+    static int hue100(int r, int g, int b, int max, int delta) {
+        float hue;
+        if (r == max) {
+            hue = float(g - b) / float(delta);
+            if (hue < 0.0f) hue += 6.0f;
+        } else if (g == max) {
+            hue = float(b - r) / float(delta) + 2.0f;
+        } else {
+            hue = float(r - g) / float(delta) + 4.0f;
+        }
+        return int(hue * 6000.0f + 0.5f);
+    }
+
+    static float labCurve(float t) {
+        constexpr float delta = 6.0f / 29.0f;
+        return t > delta * delta * delta ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f;
+    }
+
+    template <size_t N>
+    static void copyLatin1(char (&out)[N], const QString& s) {
+        const QByteArray latin1 = s.toLatin1();
+        Q_ASSERT(latin1.size() < qsizetype(N));
+        std::memcpy(out, latin1.constData(), latin1.size() + 1);
+    }
+
+    static char* text(char* p, const char* s) {
+        while (*s) *p++ = *s++;
+        return p;
+    }
+
+    char* hex(char* p, int a, int b, int c) const {
+        std::memcpy(p, hex_[a], 2);
+        std::memcpy(p + 2, hex_[b], 2);
+        std::memcpy(p + 4, hex_[c], 2);
+        return p + 6;
+    }
+
+    // -1 (undefined hue) .. 999
+    static char* decimal(char* p, int v) {
+        if (v < 0) {
+            *p++ = '-';
+            v = -v;
+        }
+        if (v >= 100) *p++ = char('0' + v / 100);
+        if (v >= 10) *p++ = char('0' + v / 10 % 10);
+        *p++ = char('0' + v % 10);
+        return p;
+    }
+
+    static char* decimals(char* p, int a, int b, int c) {
+        p = decimal(p, a);
+        p = text(p, ", ");
+        p = decimal(p, b);
+        p = text(p, ", ");
+        return decimal(p, c);
+    }
+
+    // "h, s%, v%)" with the 0..255 components scaled like the reference
+    static char* percentages(char* p, int hue, int saturation, int value) {
+        p = decimal(p, hue);
+        p = text(p, ", ");
+        p = decimal(p, saturation * 100 / 255);
+        p = text(p, "%, ");
+        p = decimal(p, value * 100 / 255);
+        return text(p, "%)");
+    }
+
+    static char* fixed(char* p, float v, int places) {
+        static const int scales[] = {1, 10, 100, 1000, 10000};
+        const int scale = scales[places];
+        long n = std::lround(double(v) * scale);
+        if (n < 0) {
+            *p++ = '-';
+            n = -n;
+        }
+        char digits[16];
+        int count = 0;
+        long whole = n / scale;
+        do {
+            digits[count++] = char('0' + whole % 10);
+            whole /= 10;
+        } while (whole > 0);
+        while (count > 0) *p++ = digits[--count];
+        *p++ = '.';
+        long fraction = n % scale;
+        for (int d = scale / 10; d > 0; d /= 10) {
+            *p++ = char('0' + fraction / d);
+            fraction %= d;
+        }
+        return p;
+    }
+
+    char hex_[256][2];
+    char unit3_[256][6];   // "0.000" .. "1.000"
+    char alpha2_[256][5];  // "0.00" .. "1.00"
+    float linear_[256];
+    bool exactHsl_ = false;
+};
+
+// ColorFormatter output as a QString, for the clipboard and the magnifier readout
+QString formatColor(const QColor& color, ColorFormat format);
+
+// names used on the command line
+bool parseColorFormat(const QString& name, ColorFormat* format);
+QString colorFormatName(ColorFormat format);
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <QApplication>
+#include <QClipboard>
+#include <QCursor>
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScreen>
+#include <QTimer>
+#include <QWheelEvent>
+#include <QWidget>
+#include <memory>
+
+#include "capture.h"
+#include "magnifier.h"
+#include "namedcolors.h"
+#include "overlay.h"
+#include "sampling.h"
+#include "trace.h"
+
+// Live (non-frozen) sampling: a small magnifier window next to the cursor
+// that regrabs only the pixels under it every display refresh, so video and
+// animations stay live. While active it holds the pointer and keyboard grab;
+// a click anywhere picks and the window underneath never sees it.
+class LiveMagnifier : public QWidget {
+    Q_OBJECT
+
+   public:
+    LiveMagnifier() {
+        setWindowFlags(Qt::FramelessWindowHint |
+                       Qt::WindowStaysOnTopHint |
+                       Qt::Tool |
+                       Qt::BypassWindowManagerHint);
+        setAttribute(Qt::WA_OpaquePaintEvent);
+        setAttribute(Qt::WA_NoSystemBackground);
+
+        timer_.setTimerType(Qt::PreciseTimer);
+        connect(&timer_, &QTimer::timeout, this, &LiveMagnifier::captureFrame);
+    }
+
+    bool isActive() const { return backend_ != nullptr; }
+
+    // the frozen magnifier's zoom and side, so both modes look the same; the
+    // wheel and +/- change the zoom during a session
+    void setMagnifier(int zoom, int size) {
+        zoom_ = qBound(kMinZoom, zoom, kMaxZoom);
+        magnifierSize_ = size;
+    }
+
+    // the first backend in order that can grab a region is used for the
+    // whole session; false when none can
+    bool start(const QList<CaptureBackend*>& order, ColorFormat format, int sampleSize,
+               std::shared_ptr<const NamedColorIndex> namedColors, NamedColorMode namedColorMode, bool showHud) {
+        stop();
+        colorFormat_ = format;
+        sampleSize_ = sampleSize;
+        namedColors_ = std::move(namedColors);
+        namedColorMode_ = namedColorMode;
+        hudEnabled_ = showHud;
+
+        // no larger than the screen the session starts on
+        if (QScreen* screen = QGuiApplication::screenAt(QCursor::pos())) {
+            side_ = qMin(magnifierSize_, qMin(screen->geometry().width(),
+                                              screen->geometry().height() - kReadoutHeight - kHudHeight));
+        } else {
+            side_ = magnifierSize_;
+        }
+        side_ = qMax(3, side_);
+        layoutMagnifier();
+
+        const QRect probe = sourceRect(QCursor::pos());
+        for (CaptureBackend* backend : order) {
+            if (backend->isAvailable() && backend->captureRegion(probe, capture_)) {
+                backend_ = backend;
+                break;
+            }
+        }
+        if (!backend_) return false;
+
+        captureStats_ = FrameStats();
+        readout_.reset();
+        lastCursor_ = QPoint(-1000, -1000);
+        resize(side_, side_ + kReadoutHeight + (hudEnabled_ ? kHudHeight : 0));
+        show();
+        raise();
+        grabMouse(Qt::CrossCursor);
+        grabKeyboard();
+
+        captureFrame();
+        timer_.start();
+        return true;
+    }
+
+    void stop() {
+        if (!backend_) return;
+        timer_.stop();
+        releaseMouse();
+        releaseKeyboard();
+        hide();
+        captureStats_.report(QString("live capture (%1)").arg(backend_->name()));
+        backend_ = nullptr;
+        capture_ = QImage();
+        namedColors_.reset();
+        emit finished();
+    }
+
+   protected:
+    void paintEvent(QPaintEvent*) override {
+        TraceSpan span("live paint");
+        QPainter painter(this);
+        painter.fillRect(rect(), QColor(30, 30, 30));
+        // a grab from before a zoom change may be too small until the next one
+        if (capture_.isNull() || capture_.width() < capturePixels_ || capture_.height() < capturePixels_) return;
+
+        // the centre capturePixels_ square of the grab, zoomed into the preallocated buffer
+        const PixelSampler sampler(capture_);
+        const int offset = (capture_.width() - capturePixels_) / 2;
+        MagnifierOptions options;
+        options.grid = drawZoom_ >= 4;
+        options.marker = QPoint(capturePixels_ / 2, capturePixels_ / 2);
+        magnifyNearest(sampler.scanLine(offset) + offset, sampler.stride(), capturePixels_, capturePixels_, drawZoom_,
+                       reinterpret_cast<QRgb*>(magnifierBuffer_.bits()), magnifierBuffer_.bytesPerLine(), options);
+        const int margin = (side_ - capturePixels_ * drawZoom_) / 2;
+        painter.drawImage(QPoint(margin, margin), magnifierBuffer_);
+
+        readout_.update(sampledColor(), colorFormat_, namedColors_.get());
+        readout_.draw(painter, QRect(0, side_, side_, kReadoutHeight));
+
+        if (hudEnabled_) {
+            const QRect hud(0, side_ + kReadoutHeight, side_, kHudHeight);
+            painter.setPen(Qt::white);
+            painter.drawText(hud.adjusted(6, 0, -6, 0), Qt::AlignLeft | Qt::AlignVCenter,
+                             QString("grab p50 %1 p99 %2 ms")
+                                 .arg(captureStats_.percentile(0.50) / 1e6, 0, 'f', 2)
+                                 .arg(captureStats_.percentile(0.99) / 1e6, 0, 'f', 2));
+        }
+    }
+
+    void mousePressEvent(QMouseEvent* event) override {
+        if (event->button() == Qt::LeftButton && !capture_.isNull()) {
+            QString colorText = formatPickedColor(sampledColor(), colorFormat_, namedColors_.get(), namedColorMode_);
+            QApplication::clipboard()->setText(colorText);
+            emit colorPicked(colorText);
+        }
+        stop();
+    }
+
+    void keyPressEvent(QKeyEvent* event) override {
+        if (event->key() == Qt::Key_Escape) {
+            stop();
+        } else if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal) {
+            changeZoom(1);
+        } else if (event->key() == Qt::Key_Minus) {
+            changeZoom(-1);
+        }
+    }
+
+    void wheelEvent(QWheelEvent* event) override {
+        // high-resolution wheels send fractions of a 120 unit notch
+        wheelDelta_ += event->angleDelta().y();
+        const int steps = wheelDelta_ / 120;
+        wheelDelta_ -= steps * 120;
+        if (steps != 0) changeZoom(steps);
+    }
+
+   signals:
+    void colorPicked(const QString& colorText);
+    void finished();
+    void zoomChanged(int zoom);
+
+   private slots:
+    // one region grab per display refresh even while the cursor is still,
+    // the content under it may be moving
+    void captureFrame() {
+        const QPoint cursor = QCursor::pos();
+        QScreen* screen = QGuiApplication::screenAt(cursor);
+        const qint64 periodNs = refreshPeriodNs(screen);
+        timer_.setInterval(int(periodNs / 1000000));
+
+        QElapsedTimer timer;
+        timer.start();
+        bool ok;
+        {
+            TraceSpan span("live capture");
+            span.setDetail(backend_->name());
+            ok = backend_->captureRegion(sourceRect(cursor), capture_);
+        }
+        captureStats_.record(timer.nsecsElapsed(), periodNs);
+        if (!ok) return;
+
+        if (cursor != lastCursor_ && screen) {
+            lastCursor_ = cursor;
+            move(windowPosition(cursor, screen->geometry()));
+        }
+        update();
+    }
+
+   private:
+    static constexpr int kReadoutHeight = 50;
+    static constexpr int kHudHeight = 20;
+
+    // Source pixels shown for the zoom, odd so there is a real centre pixel
+    // and at least 3, zooming less when the side cannot hold 3 at zoom_.
+    // The buffer is only reallocated when that changes, not per frame.
+    void layoutMagnifier() {
+        drawZoom_ = qMin(zoom_, side_ / 3);
+        capturePixels_ = side_ / drawZoom_;
+        if ((capturePixels_ % 2) == 0) capturePixels_ -= 1;
+        const QSize zoomed(capturePixels_ * drawZoom_, capturePixels_ * drawZoom_);
+        if (magnifierBuffer_.size() != zoomed) magnifierBuffer_ = QImage(zoomed, QImage::Format_RGB32);
+    }
+
+    void changeZoom(int steps) {
+        const int zoom = stepZoom(zoom_, steps);
+        if (zoom == zoom_) return;
+        zoom_ = zoom;
+        layoutMagnifier();
+        // the grab size follows the zoom, take a new one right away
+        captureFrame();
+        emit zoomChanged(zoom);
+    }
+
+    // enough around the cursor for the magnifier and the averaged box
+    QRect sourceRect(const QPoint& cursor) const {
+        const int side = qMax(capturePixels_, sampleSize_);
+        return QRect(cursor.x() - side / 2, cursor.y() - side / 2, side, side);
+    }
+
+    // Beside the cursor but clear of the grabbed area, or the window would
+    // end up magnifying itself. Flips sides at the screen edges.
+    QPoint windowPosition(const QPoint& cursor, const QRect& screen) const {
+        const int offset = qMax(20, qMax(capturePixels_, sampleSize_) / 2 + 8);
+        QPoint pos = cursor + QPoint(offset, offset);
+        if (pos.x() + width() > screen.right()) pos.setX(cursor.x() - offset - width());
+        if (pos.y() + height() > screen.bottom()) pos.setY(cursor.y() - offset - height());
+        return pos;
+    }
+
+    QRgb sampledColor() const {
+        const PixelSampler sampler(capture_);
+        const QPoint centre(capture_.width() / 2, capture_.height() / 2);
+        if (sampleSize_ <= 1) return sampler.pixel(centre);
+        const int radius = sampleSize_ / 2;
+        return averageBox(sampler, QRect(centre.x() - radius, centre.y() - radius, sampleSize_, sampleSize_));
+    }
+
+    QTimer timer_;
+    CaptureBackend* backend_ = nullptr;  // set while a session runs
+    QImage capture_;  // the last grab, sourceRect() around the cursor
+    QImage magnifierBuffer_;  // zoomed grid, sized by layoutMagnifier()
+    int zoom_ = 12;
+    int magnifierSize_ = 150;  // as set, side_ is what the screen allowed
+    int side_ = 150;
+    int drawZoom_ = 12;
+    int capturePixels_ = 11;
+    int wheelDelta_ = 0;  // wheel rotation short of a notch
+    ColorFormat colorFormat_ = ColorFormat::HTML;
+    int sampleSize_ = 1;
+    std::shared_ptr<const NamedColorIndex> namedColors_;
+    NamedColorMode namedColorMode_ = NamedColorMode::Show;
+    ColorReadout readout_;
+    QPoint lastCursor_;
+    FrameStats captureStats_;  // region grab time per frame, over budget counts as dropped
+    bool hudEnabled_ = false;
+};
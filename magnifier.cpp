@@ -0,0 +1,195 @@
+#include "magnifier.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+#include <immintrin.h>
+#endif
+
+namespace magnifier_detail {
+
+void expandRowScalar(const QRgb* src, int width, int zoom, QRgb* dst) {
+    for (int x = 0; x < width; ++x) {
+        const QRgb p = src[x];
+        for (int i = 0; i < zoom; ++i) *dst++ = p;
+    }
+}
+
+#if defined(__SSE2__)
+void expandRowSse2(const QRgb* src, int width, int zoom, QRgb* dst) {
+    for (int x = 0; x < width; ++x) {
+        const QRgb p = src[x];
+        const __m128i v = _mm_set1_epi32(int(p));
+        int i = 0;
+        for (; i + 4 <= zoom; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+        for (; i < zoom; ++i) dst[i] = p;
+        dst += zoom;
+    }
+}
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLORPICKER_HAVE_AVX2_KERNEL
+__attribute__((target("avx2"))) void expandRowAvx2(const QRgb* src, int width, int zoom, QRgb* dst) {
+    for (int x = 0; x < width; ++x) {
+        const QRgb p = src[x];
+        const __m256i v = _mm256_set1_epi32(int(p));
+        int i = 0;
+        for (; i + 8 <= zoom; i += 8) _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+        if (i + 4 <= zoom) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(v));
+            i += 4;
+        }
+        for (; i < zoom; ++i) dst[i] = p;
+        dst += zoom;
+    }
+}
+#endif
+
+using ExpandRowFn = void (*)(const QRgb*, int, int, QRgb*);
+
+ExpandRowFn selectExpandRow() {
+#ifdef COLORPICKER_HAVE_AVX2_KERNEL
+    if (__builtin_cpu_supports("avx2")) return expandRowAvx2;
+#endif
+#if defined(__SSE2__)
+    return expandRowSse2;
+#else
+    return expandRowScalar;
+#endif
+}
+
+ExpandRowFn kernelRow(MagnifierKernel kernel) {
+    switch (kernel) {
+        case MagnifierKernel::Auto:
+            break;
+        case MagnifierKernel::Scalar:
+            return expandRowScalar;
+        case MagnifierKernel::Sse2:
+#if defined(__SSE2__)
+            return expandRowSse2;
+#else
+            return nullptr;
+#endif
+        case MagnifierKernel::Avx2:
+#ifdef COLORPICKER_HAVE_AVX2_KERNEL
+            if (__builtin_cpu_supports("avx2")) return expandRowAvx2;
+#endif
+            return nullptr;
+    }
+    static const ExpandRowFn best = selectExpandRow();
+    return best;
+}
+
+}  // namespace magnifier_detail
+
+bool magnifierKernelAvailable(MagnifierKernel kernel) {
+    return magnifier_detail::kernelRow(kernel) != nullptr;
+}
+
+QRgb magnifierGridPixel(QRgb p) {
+    return (((p >> 1) & 0x7f7f7f) + 0x404040) | 0xff000000;
+}
+
+void magnifyNearest(const QRgb* src, qsizetype srcStride, int width, int height, int zoom,
+                    QRgb* dst, qsizetype dstStride, const MagnifierOptions& options) {
+    using namespace magnifier_detail;
+    const ExpandRowFn expandRow = kernelRow(options.kernel);
+    Q_ASSERT(expandRow);
+
+    const int dstWidth = width * zoom;
+    const size_t rowBytes = size_t(dstWidth) * sizeof(QRgb);
+    auto srcRow = [&](int y) { return reinterpret_cast<const QRgb*>(reinterpret_cast<const uchar*>(src) + y * srcStride); };
+    auto dstRow = [&](int y) { return reinterpret_cast<QRgb*>(reinterpret_cast<uchar*>(dst) + y * dstStride); };
+
+    for (int sy = 0; sy < height; ++sy) {
+        const QRgb* in = srcRow(sy);
+        const int top = sy * zoom;
+
+        // one expanded row, grid column patched in, then replicated down the cell
+        QRgb* first = dstRow(top);
+        expandRow(in, width, zoom, first);
+        if (options.grid) {
+            for (int sx = 0; sx < width; ++sx) first[sx * zoom] = magnifierGridPixel(in[sx]);
+        }
+        for (int i = 1; i < zoom; ++i) memcpy(dstRow(top + i), first, rowBytes);
+
+        // grid row on top of the cell
+        if (options.grid) {
+            for (int sx = 0; sx < width; ++sx) {
+                const QRgb g = magnifierGridPixel(in[sx]);
+                QRgb* cell = first + sx * zoom;
+                for (int i = 0; i < zoom; ++i) cell[i] = g;
+            }
+        }
+    }
+
+    // centre-pixel marker: a border inside the marked cell
+    const QPoint m = options.marker;
+    if (m.x() >= 0 && m.y() >= 0 && m.x() < width && m.y() < height) {
+        const int border = qMin(options.markerWidth, zoom / 2);
+        const int left = m.x() * zoom;
+        const int top = m.y() * zoom;
+        for (int y = 0; y < zoom; ++y) {
+            QRgb* row = dstRow(top + y) + left;
+            if (y < border || y >= zoom - border) {
+                for (int x = 0; x < zoom; ++x) row[x] = options.markerColor;
+            } else {
+                for (int x = 0; x < border; ++x) {
+                    row[x] = options.markerColor;
+                    row[zoom - 1 - x] = options.markerColor;
+                }
+            }
+        }
+    }
+}
+
+int stepZoom(int zoom, int steps) {
+    static constexpr int kLevels[] = {2, 3, 4, 6, 8, 12, 16, 24, 32};
+    constexpr int count = int(sizeof(kLevels) / sizeof(kLevels[0]));
+    // the first level at or above zoom; from a zoom between levels that level
+    // is already one step up
+    int level = 0;
+    while (level < count - 1 && kLevels[level] < zoom) ++level;
+    if (steps > 0 && kLevels[level] > zoom) --steps;
+    return kLevels[qBound(0, level + steps, count - 1)];
+}
+
+MagnifierTileCache::MagnifierTileCache(int maxBytes)
+    : slots_(qMax(1, maxBytes / (kTileSide * kTileSide * 4))) {}
+
+void MagnifierTileCache::setSource(const PixelSampler& source) {
+    source_ = source;
+    // the images stay for reuse
+    for (Slot& slot : slots_) slot.lastUse = 0;
+}
+
+const QImage& MagnifierTileCache::tile(int zoom, bool grid, const QPoint& index, QRect* sourceRect) {
+    const int side = tilePixels(zoom);
+    *sourceRect = QRect(index.x() * side, index.y() * side, side, side).intersected(source_.rect());
+
+    const quint64 key = quint64(zoom) << 40 | quint64(grid) << 39 | quint64(quint32(index.y())) << 20 |
+                        quint64(quint32(index.x()));
+    // a few hundred slots at most, a scan is cheaper than keeping an index;
+    // an empty slot is the least recently used one
+    Slot* victim = &slots_.front();
+    for (Slot& slot : slots_) {
+        if (slot.lastUse != 0 && slot.key == key) {
+            ++hits_;
+            slot.lastUse = ++useClock_;
+            return slot.image;
+        }
+        if (slot.lastUse < victim->lastUse) victim = &slot;
+    }
+
+    ++misses_;
+    if (victim->image.isNull()) victim->image = QImage(kTileSide, kTileSide, QImage::Format_RGB32);
+    victim->key = key;
+    victim->lastUse = ++useClock_;
+    MagnifierOptions options;
+    options.grid = grid;
+    magnifyNearest(source_.scanLine(sourceRect->y()) + sourceRect->x(), source_.stride(), sourceRect->width(),
+                   sourceRect->height(), zoom, reinterpret_cast<QRgb*>(victim->image.bits()),
+                   victim->image.bytesPerLine(), options);
+    return victim->image;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QColor>
+#include <QImage>
+#include <QPoint>
+
+#include <vector>
+
+#include "sampling.h"
+
+// Magnifier kernel: integer nearest-neighbour zoom written straight into a
+// preallocated buffer, with the pixel grid and the centre-pixel marker drawn
+// in the same pass. SSE2/AVX2 paths are picked at runtime, scalar otherwise.
+enum class MagnifierKernel { Auto, Scalar, Sse2, Avx2 };
+
+// whether this build and CPU can run kernel; Auto and Scalar always can
+bool magnifierKernelAvailable(MagnifierKernel kernel);
+
+// grid pixels are the source pixel averaged with mid grey, visible on black and white
+QRgb magnifierGridPixel(QRgb p);
+
+struct MagnifierOptions {
+    bool grid = false;        // darken/lighten the first row and column of every cell
+    QPoint marker{-1, -1};    // source pixel to frame, (-1, -1) for none
+    QRgb markerColor = 0xffff0000;
+    int markerWidth = 2;
+    MagnifierKernel kernel = MagnifierKernel::Auto;  // forced only by tests
+};
+
+// src: width x height pixels with srcStride bytes per line.
+// dst: must hold (width * zoom) x (height * zoom) pixels with dstStride bytes per line.
+void magnifyNearest(const QRgb* src, qsizetype srcStride, int width, int height, int zoom,
+                    QRgb* dst, qsizetype dstStride, const MagnifierOptions& options);
+
+// zoom range of the frozen overlay's magnifier
+constexpr int kMinZoom = 2;
+constexpr int kMaxZoom = 32;
+
+// the zoom steps (one per wheel notch) away from zoom, along 2, 3, 4, 6, 8,
+// 12, 16, 24, 32
+int stepZoom(int zoom, int steps);
+
+// Zoomed tiles of one source image, per zoom level, in an LRU bounded by
+// bytes. A tile covers kTileSide / zoom source pixels a side, about kTileSide
+// pixels once zoomed, grid included. A cursor move then only zooms the tiles
+// that scroll into the magnifier; the rest is blitted from the cache, and
+// going back to a recent zoom level is free too. Tiles live in a fixed pool of
+// kTileSide squares, each allocated on its first use and recycled from then
+// on, so a miss on the paint path zooms into memory it already has.
+class MagnifierTileCache {
+   public:
+    static constexpr int kTileSide = 256;
+
+    explicit MagnifierTileCache(int maxBytes = 32 << 20);
+
+    // drops every tile; the source must outlive its tiles' use
+    void setSource(const PixelSampler& source);
+
+    // source pixels per tile side at zoom
+    static int tilePixels(int zoom) { return qMax(1, kTileSide / zoom); }
+
+    // the tile at index (in tilePixels(zoom) units), its source rectangle
+    // (clipped to the image) in *sourceRect. Only the top-left
+    // sourceRect->size() * zoom of the image is the tile, the rest is stale.
+    // Valid until the next call.
+    const QImage& tile(int zoom, bool grid, const QPoint& index, QRect* sourceRect);
+
+    qint64 hits() const { return hits_; }
+    qint64 misses() const { return misses_; }
+
+   private:
+    struct Slot {
+        quint64 key = 0;
+        quint64 lastUse = 0;  // 0 while empty
+        QImage image;         // kTileSide square once used
+    };
+
+    PixelSampler source_;
+    std::vector<Slot> slots_;
+    quint64 useClock_ = 0;
+    qint64 hits_ = 0;
+    qint64 misses_ = 0;
+};
@@ -2,307 +2,83 @@
 #include <QSystemTrayIcon>
 #include <QMenu>
 #include <QScreen>
-#include <QPixmap>
-#include <QWidget>
+#include <QImage>
 #include <QPainter>
-#include <QPainterPath>
-#include <QMouseEvent>
-#include <QClipboard>
 #include <QCursor>
 #include <QMessageBox>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QMap>
 #include <QDebug>
-#include <QProcess>
-#include <QTemporaryDir>
-#include <QWindow>
 #include <QActionGroup>
 #include <QFile>
+#include <QFileDialog>
 #include <QSettings>
-
-enum class ColorFormat {
-    HTML,       // RRGGBB (hex without #)
-    HEX,        // #RRGGBB
-    DelphiHex,  // $00BBGGRR
-    VBHex,      // &H00BBGGRR&
-    RGBA,       // rgba(r, g, b, a)
-    RGB,        // rgb(r, g, b)
-    RGBFloat,   // r.rrr, g.ggg, b.bbb
-    HSV,        // hsv(h, s%, v%)
-    HSL         // hsl(h, s%, l%)
-};
-
-QString formatColor(const QColor& color, ColorFormat format) {
-    switch (format) {
-        case ColorFormat::HTML:
-            return color.name().toUpper().mid(1);  // Remove #
-        case ColorFormat::HEX:
-            return color.name().toUpper();
-        case ColorFormat::DelphiHex:
-            return QString("$00%1%2%3")
-                .arg(color.blue(), 2, 16, QChar('0'))
-                .arg(color.green(), 2, 16, QChar('0'))
-                .arg(color.red(), 2, 16, QChar('0'))
-                .toUpper();
-        case ColorFormat::VBHex:
-            return QString("&H00%1%2%3&")
-                .arg(color.blue(), 2, 16, QChar('0'))
-                .arg(color.green(), 2, 16, QChar('0'))
-                .arg(color.red(), 2, 16, QChar('0'))
-                .toUpper();
-        case ColorFormat::RGBA:
-            return QString("rgba(%1, %2, %3, %4)")
-                .arg(color.red())
-                .arg(color.green())
-                .arg(color.blue())
-                .arg(color.alphaF(), 0, 'f', 2);
-        case ColorFormat::RGB:
-            return QString("rgb(%1, %2, %3)")
-                .arg(color.red())
-                .arg(color.green())
-                .arg(color.blue());
-        case ColorFormat::RGBFloat:
-            return QString("%1, %2, %3")
-                .arg(color.redF(), 0, 'f', 3)
-                .arg(color.greenF(), 0, 'f', 3)
-                .arg(color.blueF(), 0, 'f', 3);
-        case ColorFormat::HSV:
-            return QString("hsv(%1, %2%, %3%)")
-                .arg(color.hsvHue())
-                .arg(color.hsvSaturation() * 100 / 255)
-                .arg(color.value() * 100 / 255);
-        case ColorFormat::HSL:
-            return QString("hsl(%1, %2%, %3%)")
-                .arg(color.hslHue())
-                .arg(color.hslSaturation() * 100 / 255)
-                .arg(color.lightness() * 100 / 255);
-    }
-    return color.name().toUpper().mid(1);
-}
-
-class ColorPickerOverlay : public QWidget {
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <QPointer>
+
+#include "capture.h"
+#include "colorformat.h"
+#include "livemagnifier.h"
+#include "namedcolors.h"
+#include "overlay.h"
+#include "pickserver.h"
+#include "pixelwatch.h"
+#include "sampling.h"
+#include "session.h"
+#include "trace.h"
+#include "visionfilter.h"
+
+class ColorPickerApp : public QObject, public PickService {
     Q_OBJECT
 
    public:
-    ColorPickerOverlay(const QPixmap& screenshot, QScreen* screen, ColorFormat format)
-        : screenshot_(screenshot), screen_(screen), colorFormat_(format), zoomFactor_(12), lastCursor_(-1000, -1000) {
-        setWindowFlags(Qt::FramelessWindowHint |
-                       Qt::WindowStaysOnTopHint |
-                       Qt::Tool |
-                       Qt::BypassWindowManagerHint);
-        setAutoFillBackground(false);
-        setAttribute(Qt::WA_OpaquePaintEvent);
-        setAttribute(Qt::WA_NoSystemBackground);
-        setMouseTracking(true);
-        setCursor(Qt::CrossCursor);
-
-        // Set geometry to match this screen
-        setGeometry(screen->geometry());
-
-        // Single display pixmap that we update
-        displayPixmap_ = screenshot_.copy();
-
-        // Update timer for magnifier only
-        updateTimer_ = new QTimer(this);
-        connect(updateTimer_, &QTimer::timeout, this, [this]() {
-            QPoint globalCursor = QCursor::pos();
-            if (screen_->geometry().contains(globalCursor)) {
-                QPoint localCursor = globalCursor - screen_->geometry().topLeft();
-                // Only update if cursor actually moved
-                if (localCursor != lastCursor_) {
-                    lastCursor_ = localCursor;
-                    updateDisplay();
-                }
-            } else {
-                // Cursor left this screen - hide magnifier
-                if (lastCursor_ != QPoint(-1000, -1000)) {
-                    lastCursor_ = QPoint(-1000, -1000);
-                    // Redraw with just the screenshot (no magnifier)
-                    displayPixmap_ = screenshot_.copy();
-                    update();
-                }
-            }
-        });
-        updateTimer_->start(16);  // ~60 FPS
-    }
-
-    ~ColorPickerOverlay() {
-        // Explicitly clear pixmaps to free memory immediately
-        screenshot_ = QPixmap();
-        displayPixmap_ = QPixmap();
-    }
-
-   protected:
-    void paintEvent(QPaintEvent*) override {
-        QPainter painter(this);
-        painter.drawPixmap(0, 0, displayPixmap_);
-    }
-
-    void updateDisplay() {
-        // Start fresh from the screenshot
-        displayPixmap_ = screenshot_.copy();
-
-        QPainter painter(&displayPixmap_);
-
-        // Get cursor position (already verified to be on this screen)
-        QPoint cursor = lastCursor_;
-
-        drawMagnifier(painter, cursor);
-
-        // Draw crosshair
-        painter.setPen(QPen(Qt::white, 2));
-        painter.drawLine(cursor.x() - 10, cursor.y(), cursor.x() + 10, cursor.y());
-        painter.drawLine(cursor.x(), cursor.y() - 10, cursor.x(), cursor.y() + 10);
-
-        painter.end();
-
-        // Trigger repaint
-        update();
-    }
-
-    void drawMagnifier(QPainter& painter, const QPoint& cursor) {
-        int magnifierSize = 150;
-        int offset = 20;
-
-        // Position magnifier near cursor (adjust to stay on screen)
-        QPoint magnifierPos = cursor + QPoint(offset, offset);
-        if (magnifierPos.x() + magnifierSize > width())
-            magnifierPos.setX(cursor.x() - magnifierSize - offset);
-        if (magnifierPos.y() + magnifierSize > height())
-            magnifierPos.setY(cursor.y() - magnifierSize - offset);
-
-        // Extract region around cursor from the original screenshot.
-        // Important: use an odd number of pixels so there is a real center pixel.
-        int capturePixels = magnifierSize / zoomFactor_;
-        if (capturePixels < 3) capturePixels = 3;
-        if ((capturePixels % 2) == 0) capturePixels -= 1;
-        int radius = capturePixels / 2;
-
-        QRect sourceRect(cursor.x() - radius,
-                         cursor.y() - radius,
-                         capturePixels, capturePixels);
-
-        // Ensure source rect is within bounds
-        sourceRect = sourceRect.intersected(screenshot_.rect());
-
-        if (sourceRect.isEmpty()) return;
-
-        // ### commented this out, border is not working as expected, might fix later
-        // Draw magnifier background
-        // painter.setPen(QPen(Qt::black, 3));
-        // painter.setBrush(Qt::white);
-        // painter.drawRect(magnifierPos.x(), magnifierPos.y(),
-        //                  magnifierSize, magnifierSize);
-
-        // Draw zoomed image from original screenshot with no smoothing
-        QPixmap zoomed = screenshot_.copy(sourceRect)
-                             .scaled(sourceRect.width() * zoomFactor_,
-                                     sourceRect.height() * zoomFactor_,
-                                     Qt::IgnoreAspectRatio,
-                                     Qt::FastTransformation);
-
-        // Center the zoomed image in the magnifier
-        int xOffset = (magnifierSize - zoomed.width()) / 2;
-        int yOffset = (magnifierSize - zoomed.height()) / 2;
-        painter.drawPixmap(magnifierPos.x() + xOffset, magnifierPos.y() + yOffset, zoomed);
-
-        // pixel indicatoor
-        QPoint cursorInSource = cursor - sourceRect.topLeft();
-        QRect pixelRect(magnifierPos.x() + xOffset + cursorInSource.x() * zoomFactor_,
-                        magnifierPos.y() + yOffset + cursorInSource.y() * zoomFactor_,
-                        zoomFactor_, zoomFactor_);
-
-        painter.setPen(QPen(Qt::red, 2));
-        painter.setBrush(Qt::NoBrush);
-        painter.drawRect(pixelRect);
-
-        // Get and display color at cursor from original screenshot
-        QColor color = screenshot_.toImage().pixelColor(cursor);
-
-        // Draw color info box - show only the selected format
-        QString colorText = formatColor(color, colorFormat_);
-
-        QRect textRect(magnifierPos.x(), magnifierPos.y() + magnifierSize + 5,
-                       magnifierSize, 50);
-        painter.fillRect(textRect, QColor(0, 0, 0, 200));
-
-        // Draw color preview square
-        int squareSize = 30;
-        int squarePadding = 10;
-        QRect colorSquare(textRect.left() + squarePadding,
-                          textRect.top() + (textRect.height() - squareSize) / 2,
-                          squareSize, squareSize);
-
-        // Fill with the actual color
-        painter.fillRect(colorSquare, color);
-
-        // Draw white border around the square
-        painter.setPen(QPen(Qt::white, 2));
-        painter.setBrush(Qt::NoBrush);
-        painter.drawRect(colorSquare);
-
-        // Draw text next to the color square
-        painter.setPen(Qt::white);
-        QRect textOnlyRect(colorSquare.right() + squarePadding, textRect.top(),
-                           textRect.width() - colorSquare.width() - squarePadding * 3, textRect.height());
-        painter.drawText(textOnlyRect, Qt::AlignLeft | Qt::AlignVCenter, colorText);
-    }
-
-    void mousePressEvent(QMouseEvent* event) override {
-        if (event->button() == Qt::LeftButton) {
-            // Get color from screenshot at click position
-            QPoint localPos = event->pos();
-            if (localPos.x() >= 0 && localPos.x() < screenshot_.width() &&
-                localPos.y() >= 0 && localPos.y() < screenshot_.height()) {
-                QColor color = screenshot_.toImage().pixelColor(localPos);
-
-                // Copy to clipboard in selected format
-                QString colorText = formatColor(color, colorFormat_);
-                QClipboard* clipboard = QApplication::clipboard();
-                clipboard->setText(colorText);
-
-                emit colorPicked(colorText);
-            }
-            emit closeAllOverlays();
-        } else if (event->button() == Qt::RightButton) {
-            // Cancel
-            emit closeAllOverlays();
-        }
-    }
-
-    void keyPressEvent(QKeyEvent* event) override {
-        if (event->key() == Qt::Key_Escape) {
-            emit closeAllOverlays();
-        }
-    }
-
-   signals:
-    void colorPicked(const QString& colorText);
-    void closeAllOverlays();
-
-   private:
-    QPixmap screenshot_;     // Original screenshot
-    QPixmap displayPixmap_;  // What we actually display (updated each frame)
-    QScreen* screen_;
-    ColorFormat colorFormat_;
-    int zoomFactor_;
-    QTimer* updateTimer_;
-    QPoint lastCursor_;
-};
-
-class ColorPickerApp : public QObject {
-    Q_OBJECT
-
-   public:
-    ColorPickerApp() : activeOverlays_(), currentFormat_(ColorFormat::HTML) {
+    explicit ColorPickerApp(const QString& backendOverride = QString(), bool showHud = false,
+                            const QString& namedColorsOverride = QString())
+        : activeOverlays_(), showHud_(showHud), currentFormat_(ColorFormat::HTML) {
         // load format
         QSettings settings;
         int savedFormat = settings.value("colorFormat", static_cast<int>(ColorFormat::HTML)).toInt();
         currentFormat_ = static_cast<ColorFormat>(savedFormat);
 
+        // capture backend, a command line/environment choice overrides the saved one
+        captureBackends_ = createCaptureBackends();
+        captureBackendName_ = backendOverride.isEmpty()
+                                  ? settings.value("captureBackend", "auto").toString()
+                                  : backendOverride;
+        warmPool_ = settings.value("warmOverlays", false).toBool();
+        sampleSize_ = qBound(1, settings.value("sampleSize", 1).toInt(), 101);
+        paletteSize_ = qBound(1, settings.value("paletteSize", 5).toInt(), 32);
+        zoom_ = qBound(kMinZoom, settings.value("magnifierZoom", 12).toInt(), kMaxZoom);
+        magnifierSize_ = qBound(100, settings.value("magnifierSize", 150).toInt(), 1200);
+        namedColorMode_ = static_cast<NamedColorMode>(
+            qBound(0, settings.value("namedColorMode", 0).toInt(), static_cast<int>(NamedColorMode::CopyName)));
+        visionMode_ = static_cast<VisionMode>(qBound(0, settings.value("visionMode", 0).toInt(), kVisionModeCount - 1));
+        saveSessions_ = settings.value("saveSessions", false).toBool();
+        sessions_ = std::make_unique<SessionStore>(SessionStore::defaultDirectory(),
+                                                   qBound(1, settings.value("sessionHistorySize", 10).toInt(), 100));
+        loadNamedColors(namedColorsOverride.isEmpty() ? settings.value("namedColorsFile").toString()
+                                                      : namedColorsOverride);
+
         // tray icon
         trayIcon_ = new QSystemTrayIcon(this);
 
+        // single frame clock shared by all overlays
+        frameScheduler_ = new FrameScheduler(this);
+
         // get icon
         QIcon icon(":/icon.svg");
 
@@ -313,6 +89,11 @@ class ColorPickerApp : public QObject {
         QMenu* menu = new QMenu();
         QAction* pickAction = menu->addAction("Pick Color");
         pickAction->setFont(QFont(pickAction->font().family(), pickAction->font().pointSize(), QFont::Bold));
+        QAction* livePickAction = menu->addAction("Pick Color (Live)");
+
+        // recent sessions submenu, listed from disk each time it opens
+        sessionMenu_ = menu->addMenu("Recent Sessions");
+        connect(sessionMenu_, &QMenu::aboutToShow, this, &ColorPickerApp::rebuildSessionMenu);
         menu->addSeparator();
 
         // formats submenu
@@ -330,9 +111,83 @@ class ColorPickerApp : public QObject {
         addFormatAction(formatMenu, formatGroup, "RGB Float", ColorFormat::RGBFloat, currentFormat_ == ColorFormat::RGBFloat);
         addFormatAction(formatMenu, formatGroup, "HSV (HSB)", ColorFormat::HSV, currentFormat_ == ColorFormat::HSV);
         addFormatAction(formatMenu, formatGroup, "HSL", ColorFormat::HSL, currentFormat_ == ColorFormat::HSL);
+        addFormatAction(formatMenu, formatGroup, "CIELAB", ColorFormat::Lab, currentFormat_ == ColorFormat::Lab);
+        addFormatAction(formatMenu, formatGroup, "OKLab", ColorFormat::OKLab, currentFormat_ == ColorFormat::OKLab);
+        addFormatAction(formatMenu, formatGroup, "OKLCH", ColorFormat::OKLCH, currentFormat_ == ColorFormat::OKLCH);
+        addFormatAction(formatMenu, formatGroup, "CMYK", ColorFormat::CMYK, currentFormat_ == ColorFormat::CMYK);
+
+        // sample size submenu, averaged over a square around the cursor
+        QMenu* sampleMenu = menu->addMenu("Sample Size");
+        QActionGroup* sampleGroup = new QActionGroup(this);
+        sampleGroup->setExclusive(true);
+        addSampleSizeAction(sampleMenu, sampleGroup, "Point Sample", 1);
+        for (int size : {3, 5, 11, 31, 51, 101}) {
+            addSampleSizeAction(sampleMenu, sampleGroup, QString("%1 x %1 Average").arg(size), size);
+        }
+
+        // magnifier size submenu, the zoom follows the wheel and +/- on the overlay
+        QMenu* magnifierMenu = menu->addMenu("Magnifier Size");
+        QActionGroup* magnifierGroup = new QActionGroup(this);
+        magnifierGroup->setExclusive(true);
+        for (int size : {150, 200, 300, 400, 600, 800}) {
+            addMagnifierSizeAction(magnifierMenu, magnifierGroup, QString("%1 px").arg(size), size);
+        }
+
+        // palette submenu, colors copied for a drag selection
+        QMenu* paletteMenu = menu->addMenu("Palette Size");
+        QActionGroup* paletteGroup = new QActionGroup(this);
+        paletteGroup->setExclusive(true);
+        for (int size : {3, 5, 8, 12, 16}) {
+            addPaletteSizeAction(paletteMenu, paletteGroup, QString("%1 Colors").arg(size), size);
+        }
+
+        // named colors submenu, nearest entry of a user palette
+        QMenu* namedMenu = menu->addMenu("Named Colors");
+        QAction* loadNamedAction = namedMenu->addAction("Load Palette...");
+        connect(loadNamedAction, &QAction::triggered, this, &ColorPickerApp::chooseNamedColors);
+        QAction* clearNamedAction = namedMenu->addAction("Clear Palette");
+        connect(clearNamedAction, &QAction::triggered, this, [this]() {
+            namedColors_.reset();
+            QSettings settings;
+            settings.remove("namedColorsFile");
+        });
+        namedMenu->addSeparator();
+        QActionGroup* namedGroup = new QActionGroup(this);
+        namedGroup->setExclusive(true);
+        addNamedColorModeAction(namedMenu, namedGroup, "Show Nearest Name", NamedColorMode::Show);
+        addNamedColorModeAction(namedMenu, namedGroup, "Copy Nearest Color", NamedColorMode::SnapColor);
+        addNamedColorModeAction(namedMenu, namedGroup, "Copy Nearest Name", NamedColorMode::CopyName);
+
+        // vision preview submenu, also cycled with V on the overlay
+        QMenu* visionMenu = menu->addMenu("Vision Preview");
+        visionGroup_ = new QActionGroup(this);
+        visionGroup_->setExclusive(true);
+        for (int mode = 0; mode < kVisionModeCount; ++mode) {
+            addVisionModeAction(visionMenu, visionGroup_, static_cast<VisionMode>(mode));
+        }
+
+        // capture backend submenu
+        QMenu* backendMenu = menu->addMenu("Capture Backend");
+        QActionGroup* backendGroup = new QActionGroup(this);
+        backendGroup->setExclusive(true);
+        addBackendAction(backendMenu, backendGroup, "Automatic", "auto", true);
+        for (const auto& backend : captureBackends_) {
+            addBackendAction(backendMenu, backendGroup, backend->name(), backend->name(), backend->isAvailable());
+        }
 
         menu->addSeparator();
 
+        // trade idle memory for hotkey-to-magnifier latency
+        QAction* warmAction = menu->addAction("Keep Overlays Ready");
+        warmAction->setCheckable(true);
+        warmAction->setChecked(warmPool_);
+        connect(warmAction, &QAction::toggled, this, [this](bool checked) {
+            warmPool_ = checked;
+            QSettings settings;
+            settings.setValue("warmOverlays", checked);
+            rebuildWarmPool();
+        });
+
         // autostart option
         // todo: move this to its own function
         QAction* autostartAction = menu->addAction("Start with Computer");
@@ -344,12 +199,24 @@ class ColorPickerApp : public QObject {
         QAction* quitAction = menu->addAction("Quit");
 
         connect(pickAction, &QAction::triggered, this, &ColorPickerApp::startColorPicker);
+        connect(livePickAction, &QAction::triggered, this, &ColorPickerApp::startLivePicker);
         connect(quitAction, &QAction::triggered, qApp, &QApplication::quit);
         connect(trayIcon_, &QSystemTrayIcon::activated,
                 this, &ColorPickerApp::onTrayActivated);
 
         trayIcon_->setContextMenu(menu);
         trayIcon_->show();
+
+        // pooled overlays and buffers follow the screen layout
+        for (QScreen* screen : QGuiApplication::screens()) {
+            watchScreen(screen);
+        }
+        connect(qApp, &QGuiApplication::screenAdded, this, [this](QScreen* screen) {
+            watchScreen(screen);
+            rebuildWarmPool();
+        });
+        connect(qApp, &QGuiApplication::screenRemoved, this, &ColorPickerApp::rebuildWarmPool);
+        rebuildWarmPool();
     }
 
     void addFormatAction(QMenu* menu, QActionGroup* group, const QString& text, ColorFormat format, bool checked) {
@@ -364,6 +231,66 @@ class ColorPickerApp : public QObject {
         });
     }
 
+    // socket API for scripts, see PickServer
+    bool listen(const QString& path) {
+        pickServer_ = new PickServer(this, this);
+        if (!pickServer_->listen(path)) {
+            qWarning().noquote() << QString("cannot listen on %1: %2").arg(path, pickServer_->errorString());
+            delete pickServer_;
+            pickServer_ = nullptr;
+            return false;
+        }
+        qInfo().noquote() << QString("listening on %1").arg(path);
+        return true;
+    }
+
+    // PickService
+    void startInteractivePick() override {
+        // a pick already on screen answers this request too
+        if (captureInFlight_ || !activeOverlays_.isEmpty()) return;
+        startColorPicker();
+    }
+
+    bool captureBusy() const override { return captureInFlight_; }
+
+    // A region grab when one screen holds the rectangle, which is what a warm
+    // request usually costs. Otherwise the whole desktop into a buffer kept
+    // for the server, viewed at rect.
+    void captureRect(const QRect& rect, std::function<void(const QImage&)> done) override {
+        QScreen* screen = QGuiApplication::screenAt(rect.center());
+        const bool region = screen && screen->geometry().contains(rect);
+        socketCaptureInFlight_ = true;
+        captureRectAsync(rect, region, virtualDesktopGeometry(), captureOrder(captureBackends_, captureBackendName_),
+                         0, std::move(done));
+    }
+    QJsonArray pickHistory(int limit) const override {
+        QJsonArray history;
+        for (int i = 0; i < qMin(limit, int(history_.size())); ++i) history.append(history_[i]);
+        return history;
+    }
+
+    PixelWatcher* pixelWatcher() override {
+        if (!pixelWatcher_) {
+            pixelWatcher_ = new PixelWatcher(this);
+            pixelWatcher_->setCaptureOrder(captureOrder(captureBackends_, captureBackendName_));
+            pixelWatcher_->setInterval(watchIntervalMs_);
+            // an interactive capture in the pool may be using the same backend
+            pixelWatcher_->setBusyCheck([this]() { return captureInFlight_ || socketCaptureInFlight_; });
+            connect(pixelWatcher_, &PixelWatcher::colorChanged, this, &ColorPickerApp::onWatchChanged);
+        }
+        return pixelWatcher_;
+    }
+
+    // --watch: changes are printed to stdout as JSON lines and shown by the tray
+    void watch(const QRect& area, float threshold) {
+        commandLineWatches_.insert(pixelWatcher()->addTarget(area, threshold));
+    }
+
+    void setWatchInterval(int ms) {
+        watchIntervalMs_ = ms;
+        if (pixelWatcher_) pixelWatcher_->setInterval(ms);
+    }
+
    private slots:
     void onTrayActivated(QSystemTrayIcon::ActivationReason reason) {
         if (reason == QSystemTrayIcon::Trigger) {
@@ -372,94 +299,630 @@ class ColorPickerApp : public QObject {
     }
 
     void startColorPicker() {
+        // a capture is already running, this press joins that pick
+        if (captureInFlight_) return;
+        if (socketCaptureInFlight_) {
+            deferredStart_ = &ColorPickerApp::startColorPicker;
+            return;
+        }
+        TraceSpan span("startColorPicker");
+
+        if (liveMagnifier_) liveMagnifier_->stop();
+
         // cleanup overlays
         closeAllOverlays();
 
-        // screenshot using spectacle
-        QList<QScreen*> screens = QGuiApplication::screens();
-        if (screens.isEmpty()) return;
+        if (QGuiApplication::screens().isEmpty()) return;
 
-        QMap<QScreen*, QPixmap> screenshots;
-        QTemporaryDir tempDir;
+        // the capture buffer is handed over, not shared, so backends fill it in place
+        captureInFlight_ = true;
+        captureAsync(pickGeneration_, virtualDesktopGeometry(),
+                     captureOrder(captureBackends_, captureBackendName_), 0, std::move(captureBuffer_));
+    }
 
-        if (!tempDir.isValid()) {
+    // Live mode: no frozen capture, only the pixels under the cursor are
+    // grabbed again every display refresh
+    void startLivePicker() {
+        if (captureInFlight_) return;
+        if (socketCaptureInFlight_) {
+            deferredStart_ = &ColorPickerApp::startLivePicker;
             return;
         }
+        TraceSpan span("startLivePicker");
+        closeAllOverlays();
+
+        if (!liveMagnifier_) {
+            liveMagnifier_ = new LiveMagnifier();
+            connect(liveMagnifier_, &LiveMagnifier::colorPicked, this, &ColorPickerApp::onColorPicked);
+            connect(liveMagnifier_, &LiveMagnifier::finished, this, []() { Tracer::instance().flush(); });
+            connect(liveMagnifier_, &LiveMagnifier::zoomChanged, this, &ColorPickerApp::setZoom);
+        }
+        liveMagnifier_->setMagnifier(zoom_, magnifierSize_);
+        if (!liveMagnifier_->start(captureOrder(captureBackends_, captureBackendName_), currentFormat_, sampleSize_,
+                                   namedColors_, namedColorMode_, showHud_)) {
+            trayIcon_->showMessage("Color Picker", "No capture backend can grab a screen region for live mode",
+                                   QSystemTrayIcon::Warning, 3000);
+        }
+    }
+
+    void closeAllOverlays() {
+        const bool pickEnded = !activeOverlays_.isEmpty();
+        // results still on their way for the old pick are dropped
+        ++pickGeneration_;
+        frameScheduler_->reset();
+        for (ColorPickerOverlay* overlay : activeOverlays_) {
+            overlay->endPick();
+            if (warmOverlays_.key(overlay)) {
+                overlay->hide();
+            } else {
+                overlay->close();
+                overlay->deleteLater();
+            }
+        }
+        activeOverlays_.clear();
+        integralOverlay_ = nullptr;
+
+        // vision previews belong to this pick's capture
+        visionCache_.clear();
+
+        // before the capture can be released below; the store shares it
+        if (pickEnded) storeSession();
+
+        // no views are left, free the capture right away unless it is kept warm
+        if (!warmPool_ && !captureBuffer_.isNull()) {
+            captureBuffer_ = QImage();
+            reportMemory("released", captureBuffer_);
+        }
+
+        // the trace file is complete after every pick, not only on quit
+        if (pickEnded) Tracer::instance().flush();
+
+        // closed without a pick; after a pick the clients were already answered
+        if (pickEnded && pickServer_) pickServer_->finishPick(QString(), false);
+    }
+
+    void cycleVisionMode(int step) {
+        setVisionMode(static_cast<VisionMode>((static_cast<int>(visionMode_) + step + kVisionModeCount) %
+                                              kVisionModeCount));
+        for (QAction* action : visionGroup_->actions()) {
+            action->setChecked(action->data().toInt() == static_cast<int>(visionMode_));
+        }
+    }
+
+    void onWatchChanged(int id, QRgb before, QRgb after, float distance) {
+        if (!commandLineWatches_.contains(id)) return;
+        const QRect area = pixelWatcher_->area(id);
+        const QString beforeText = formatColor(QColor::fromRgb(before), currentFormat_);
+        const QString afterText = formatColor(QColor::fromRgb(after), currentFormat_);
+
+        QJsonObject event;
+        event["event"] = "changed";
+        event["area"] = QJsonArray{area.x(), area.y(), area.width(), area.height()};
+        event["before"] = beforeText;
+        event["after"] = afterText;
+        event["distance"] = distance;
+        event["time"] = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+        const QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact) + '\n';
+        fwrite(line.constData(), 1, size_t(line.size()), stdout);
+        fflush(stdout);
+
+        QString where = QString("%1, %2").arg(area.x()).arg(area.y());
+        if (area.size() != QSize(1, 1)) where += QString(" (%1 x %2)").arg(area.width()).arg(area.height());
+        trayIcon_->showMessage("Watched Pixel Changed", QString("%1: %2 → %3").arg(where, beforeText, afterText),
+                               QSystemTrayIcon::Information, 3000);
+    }
+
+    void onPicked(const QRect& globalArea, const QString& colorText) {
+        sessionPicks_.append({globalArea, colorText, currentFormat_});
+    }
+
+    void onColorPicked(const QString& colorText) {
+        QJsonObject entry;
+        entry["text"] = colorText;
+        entry["time"] = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+        history_.prepend(entry);
+        if (history_.size() > kHistorySize) history_.removeLast();
+        if (pickServer_) pickServer_->finishPick(colorText, true);
+
+        trayIcon_->showMessage("Color Picked!",
+                               QString("Copied to clipboard: %1").arg(colorText),
+                               QSystemTrayIcon::Information, 2000);
+    }
+
+   private:
+    static constexpr int kHistorySize = 100;
+
+    // Tries order[index...] until one backend delivers. Thread-safe backends run
+    // in the pool so the tray stays responsive; the rest run on the GUI thread.
+    void captureAsync(quint64 generation, const QRect& virtualGeo, const QList<CaptureBackend*>& order, int index,
+                      QImage buffer) {
+        for (; index < order.size(); ++index) {
+            CaptureBackend* backend = order[index];
+            if (!backend->isAvailable()) continue;
+
+            if (backend->requiresGuiThread()) {
+                if (!timedCapture(backend, virtualGeo, buffer)) continue;
+                onCaptureReady(generation, virtualGeo, std::move(buffer));
+                return;
+            }
 
-        // get all screens
-        QString fullScreenshot = tempDir.path() + "/fullscreen.png";
-        QProcess spectacleProcess;
-        // take screenshot of all screens
-        spectacleProcess.start("spectacle", QStringList() << "-fb" << "-n" << "-o" << fullScreenshot);
-        spectacleProcess.waitForFinished(2000);
+            auto* watcher = new QFutureWatcher<QImage>(this);
+            connect(watcher, &QFutureWatcher<QImage>::finished, this,
+                    [this, watcher, generation, virtualGeo, order, index]() {
+                        QImage capture = watcher->result();
+                        watcher->deleteLater();
+                        if (capture.isNull()) {
+                            captureAsync(generation, virtualGeo, order, index + 1, QImage());
+                        } else {
+                            onCaptureReady(generation, virtualGeo, std::move(capture));
+                        }
+                    });
+            // moved in so the worker holds the only reference and writes without detaching
+            watcher->setFuture(QtConcurrent::run([backend, virtualGeo, buffer = std::move(buffer)]() mutable {
+                return timedCapture(backend, virtualGeo, buffer) ? buffer : QImage();
+            }));
+            return;
+        }
 
-        QPixmap fullCapture(fullScreenshot);
+        onCaptureReady(generation, virtualGeo, QImage());
+    }
 
-        if (!fullCapture.isNull()) {
-            // split ss per screen
-            for (QScreen* screen : screens) {
-                QRect geo = screen->geometry();
-                // desktop offsets
-                QRect virtualGeo = screens.first()->geometry();
-                for (QScreen* s : screens) {
-                    virtualGeo = virtualGeo.united(s->geometry());
+    // Like captureAsync for the socket's sample batches: order[index...] as
+    // region grabs, then once more as whole-desktop grabs; done runs on the GUI
+    // thread with the pixels, or a null image when no backend delivered.
+    void captureRectAsync(const QRect& rect, bool region, const QRect& virtualGeo, const QList<CaptureBackend*>& order,
+                          int index, std::function<void(const QImage&)> done) {
+        for (; index < 2 * order.size(); ++index) {
+            CaptureBackend* backend = order[index % order.size()];
+            const bool whole = index >= order.size();
+            if ((!whole && !region) || !backend->isAvailable()) continue;
+
+            auto grab = [backend, whole, rect, virtualGeo](QImage buffer) {
+                if (whole) return timedCapture(backend, virtualGeo, buffer) ? buffer : QImage();
+                return backend->captureRegion(rect, buffer) ? buffer : QImage();
+            };
+            auto finish = [this, rect, region, virtualGeo, order, index, whole, done](QImage capture) {
+                if (capture.isNull()) {
+                    captureRectAsync(rect, region, virtualGeo, order, index + 1, done);
+                    return;
+                }
+                if (whole) {
+                    serverBuffer_ = std::move(capture);
+                    capture = captureView(serverBuffer_, rect.translated(-virtualGeo.topLeft()));
                 }
+                finishSocketCapture(done, capture);
+            };
+            // handed over, not shared, so the backend fills it in place
+            QImage buffer = whole ? std::move(serverBuffer_) : QImage();
+
+            // the live magnifier grabs on the GUI thread every frame, a grab in
+            // the pool could use its backend at the same time
+            if (backend->requiresGuiThread() || (liveMagnifier_ && liveMagnifier_->isActive())) {
+                finish(grab(std::move(buffer)));
+                return;
+            }
 
-                // position the parts
-                QPoint offset = geo.topLeft() - virtualGeo.topLeft();
-                QPixmap screenShot = fullCapture.copy(offset.x(), offset.y(),
-                                                      geo.width(), geo.height());
-                screenshots[screen] = screenShot;
+            auto* watcher = new QFutureWatcher<QImage>(this);
+            connect(watcher, &QFutureWatcher<QImage>::finished, this, [watcher, finish]() {
+                QImage capture = watcher->result();
+                watcher->deleteLater();
+                finish(std::move(capture));
+            });
+            watcher->setFuture(QtConcurrent::run([grab, buffer = std::move(buffer)]() mutable {
+                return grab(std::move(buffer));
+            }));
+            return;
+        }
+
+        finishSocketCapture(done, QImage());
+    }
+
+    void finishSocketCapture(const std::function<void(const QImage&)>& done, const QImage& capture) {
+        socketCaptureInFlight_ = false;
+        done(capture);
+        // a pick asked for while the backends were busy
+        if (auto start = std::exchange(deferredStart_, nullptr)) (this->*start)();
+    }
+
+    // One buffer holds the whole virtual desktop; every overlay gets a zero-copy
+    // view of its screen, so all of them can show as soon as the capture lands.
+    void onCaptureReady(quint64 generation, const QRect& virtualGeo, QImage capture) {
+        TraceSpan span("onCaptureReady");
+        captureInFlight_ = false;
+        if (generation != pickGeneration_) {
+            // cancelled meanwhile, keep the allocation only for the warm pool
+            if (warmPool_) captureBuffer_ = std::move(capture);
+            return;
+        }
+
+        // spectacle may hand back a different size, views must stay inside the buffer
+        if (!capture.isNull() && capture.size() != virtualGeo.size()) {
+            capture = capture.copy(QRect(QPoint(0, 0), virtualGeo.size()));
+        }
+        captureBuffer_ = std::move(capture);
+        captureGeometry_ = virtualGeo;
+
+        for (QScreen* screen : QGuiApplication::screens()) {
+            QRect geo = screen->geometry();
+            ColorPickerOverlay* overlay = obtainOverlay(screen);
+            activeOverlays_.append(overlay);
+
+            {
+                TraceSpan slice("slice screen");
+                slice.setDetail(screen->name());
+                if (captureBuffer_.isNull()) {
+                    // no backend could capture
+                    QImage screenshot(geo.size(), QImage::Format_RGB32);
+                    screenshot.fill(QColor(60, 60, 60));
+                    QPainter p(&screenshot);
+                    p.setPen(Qt::white);
+                    p.setFont(QFont("Arial", 24));
+                    p.drawText(screenshot.rect(), Qt::AlignCenter,
+                               "Screenshot not available\nPlease install 'spectacle' or run under X11");
+                    p.end();
+                    overlay->setScreenshot(screenshot);
+                } else {
+                    // position the parts
+                    overlay->setScreenshot(captureView(captureBuffer_, geo.translated(-virtualGeo.topLeft())));
+                }
             }
-        } else {
-            // no spectable found
-            for (QScreen* screen : screens) {
-                QRect geo = screen->geometry();
-                QPixmap screenshot(geo.size());
-                screenshot.fill(QColor(60, 60, 60));
-                QPainter p(&screenshot);
-                p.setPen(Qt::white);
-                p.setFont(QFont("Arial", 24));
-                p.drawText(screenshot.rect(), Qt::AlignCenter,
-                           "Screenshot not available\nPlease install 'spectacle'");
-                p.end();
-                screenshots[screen] = screenshot;
+            showOverlay(overlay);
+        }
+
+        // before the first paint, so the overlays never flash the normal view
+        if (visionMode_ != VisionMode::Normal) applyVisionMode();
+
+        reportMemory("pick", captureBuffer_);
+
+        if (sampleSize_ > 1 && !captureBuffer_.isNull()) {
+            for (ColorPickerOverlay* overlay : activeOverlays_) {
+                if (overlay->overlayScreen()->geometry().contains(QCursor::pos())) {
+                    buildIntegralImage(generation, overlay);
+                }
             }
         }
+    }
 
-        // close tray menu
-        QTimer::singleShot(150, this, [this, screenshots, screens]() {
-            for (QScreen* screen : screens) {
-                ColorPickerOverlay* overlay = new ColorPickerOverlay(screenshots[screen], screen, currentFormat_);
+    // Box averages come from a summed-area table of the screen under the
+    // cursor, built in the pool; one for the whole desktop would be three
+    // times the capture. Only one table is kept, it is rebuilt when the cursor
+    // moves to another screen. Until it arrives overlays average with a plain loop.
+    void buildIntegralImage(quint64 generation, ColorPickerOverlay* overlay) {
+        if (integralOverlay_) integralOverlay_->setIntegralImage(nullptr);
+        integralOverlay_ = overlay;
+
+        auto* watcher = new QFutureWatcher<std::shared_ptr<const IntegralImage>>(this);
+        connect(watcher, &QFutureWatcher<std::shared_ptr<const IntegralImage>>::finished, this,
+                [this, watcher, generation, overlay]() {
+                    std::shared_ptr<const IntegralImage> integral = watcher->result();
+                    watcher->deleteLater();
+                    // a later pick or another screen took over meanwhile
+                    if (generation != pickGeneration_ || overlay != integralOverlay_) return;
+                    overlay->setIntegralImage(integral);
+                    reportMemory("summed-area table", captureBuffer_, integral->sizeInBytes());
+                });
+        // the shared reference keeps the pixels alive if the pick ends meanwhile
+        QImage capture = captureBuffer_;
+        const QRect rect = overlay->overlayScreen()->geometry().translated(-captureGeometry_.topLeft());
+        watcher->setFuture(QtConcurrent::run([capture, rect]() {
+            TraceSpan span("integral image");
+            QElapsedTimer timer;
+            timer.start();
+            std::shared_ptr<const IntegralImage> integral = std::make_shared<IntegralImage>(captureView(capture, rect));
+            qInfo().noquote() << QString("summed-area table: %1 ms, %2 MB")
+                                     .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2)
+                                     .arg(integral->sizeInBytes() / 1048576.0, 0, 'f', 1);
+            return integral;
+        }));
+    }
 
-                connect(overlay, &ColorPickerOverlay::colorPicked,
-                        this, &ColorPickerApp::onColorPicked);
-                connect(overlay, &ColorPickerOverlay::closeAllOverlays,
-                        this, &ColorPickerApp::closeAllOverlays);
+    // pooled overlay for the screen in warm mode, otherwise a fresh one
+    ColorPickerOverlay* obtainOverlay(QScreen* screen) {
+        if (warmPool_ && warmOverlays_.contains(screen)) {
+            return warmOverlays_.value(screen);
+        }
 
-                activeOverlays_.append(overlay);
-                overlay->showFullScreen();
-                overlay->raise();
-                overlay->activateWindow();
+        TraceSpan span("create overlay");
+        span.setDetail(screen->name());
+        ColorPickerOverlay* overlay = new ColorPickerOverlay(screen);
+        overlay->setHudEnabled(showHud_);
+
+        connect(overlay, &ColorPickerOverlay::colorPicked,
+                this, &ColorPickerApp::onColorPicked);
+        connect(overlay, &ColorPickerOverlay::closeAllOverlays,
+                this, &ColorPickerApp::closeAllOverlays);
+        connect(overlay, &ColorPickerOverlay::cursorMoved, this, [this, overlay](const QPoint& localPos) {
+            // the summed-area table follows the cursor to this screen
+            if (sampleSize_ > 1 && overlay != integralOverlay_ && !captureBuffer_.isNull()) {
+                buildIntegralImage(pickGeneration_, overlay);
             }
+            frameScheduler_->requestFrame(overlay, localPos);
+        });
+        connect(overlay, &ColorPickerOverlay::cursorLeft, this, [this, overlay]() {
+            frameScheduler_->cancel(overlay);
+        });
+        connect(overlay, &ColorPickerOverlay::cycleVisionMode, this, &ColorPickerApp::cycleVisionMode);
+        connect(overlay, &ColorPickerOverlay::picked, this, &ColorPickerApp::onPicked);
+        connect(overlay, &ColorPickerOverlay::zoomChanged, this, &ColorPickerApp::setZoom);
+
+        if (warmPool_) warmOverlays_.insert(screen, overlay);
+        return overlay;
+    }
+
+    void showOverlay(ColorPickerOverlay* overlay) {
+        TraceSpan span("show overlay");
+        span.setDetail(overlay->overlayScreen()->name());
+        overlay->setPaletteSize(paletteSize_);
+        overlay->setMagnifier(zoom_, magnifierSize_);
+        overlay->setNamedColors(namedColors_, namedColorMode_);
+        overlay->beginPick(currentFormat_, sampleSize_);
+        overlay->showFullScreen();
+        overlay->raise();
+        overlay->activateWindow();
+
+        // first frame where the cursor already is, later ones come from mouse moves
+        QRect geo = overlay->overlayScreen()->geometry();
+        QPoint globalCursor = QCursor::pos();
+        if (geo.contains(globalCursor)) {
+            frameScheduler_->requestFrame(overlay, globalCursor - geo.topLeft());
+        }
+    }
+
+    // Warm mode keeps one hidden overlay per screen alive with its native window,
+    // and the capture buffer allocated. Rebuilt whenever the screen layout changes.
+    void rebuildWarmPool() {
+        if (!warmPool_ && warmOverlays_.isEmpty()) return;
+
+        closeAllOverlays();
+        for (ColorPickerOverlay* overlay : warmOverlays_) {
+            overlay->deleteLater();
+        }
+        warmOverlays_.clear();
+
+        if (!warmPool_) return;
+        for (QScreen* screen : QGuiApplication::screens()) {
+            ColorPickerOverlay* overlay = obtainOverlay(screen);
+            overlay->winId();  // create the native window now, not on the first pick
+        }
+        // a capture in flight still owns the buffer and brings it back
+        if (!captureInFlight_) {
+            ensureCaptureBuffer(captureBuffer_, virtualDesktopGeometry().size());
+        }
+    }
+
+    void watchScreen(QScreen* screen) {
+        connect(screen, &QScreen::geometryChanged, this, &ColorPickerApp::rebuildWarmPool);
+    }
+
+    void addSampleSizeAction(QMenu* menu, QActionGroup* group, const QString& text, int size) {
+        QAction* action = menu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(sampleSize_ == size);
+        group->addAction(action);
+        connect(action, &QAction::triggered, this, [this, size]() {
+            sampleSize_ = size;
+            QSettings settings;
+            settings.setValue("sampleSize", size);
         });
     }
 
-    void closeAllOverlays() {
+    void addPaletteSizeAction(QMenu* menu, QActionGroup* group, const QString& text, int size) {
+        QAction* action = menu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(paletteSize_ == size);
+        group->addAction(action);
+        connect(action, &QAction::triggered, this, [this, size]() {
+            paletteSize_ = size;
+            QSettings settings;
+            settings.setValue("paletteSize", size);
+        });
+    }
+
+    void addMagnifierSizeAction(QMenu* menu, QActionGroup* group, const QString& text, int size) {
+        QAction* action = menu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(magnifierSize_ == size);
+        group->addAction(action);
+        connect(action, &QAction::triggered, this, [this, size]() {
+            magnifierSize_ = size;
+            QSettings settings;
+            settings.setValue("magnifierSize", size);
+        });
+    }
+
+    // from one overlay's wheel or keys; the other screens follow
+    void setZoom(int zoom) {
+        zoom_ = zoom;
+        QSettings settings;
+        settings.setValue("magnifierZoom", zoom);
+        for (ColorPickerOverlay* overlay : activeOverlays_) overlay->setMagnifier(zoom_, magnifierSize_);
+    }
+
+    void addVisionModeAction(QMenu* menu, QActionGroup* group, VisionMode mode) {
+        QAction* action = menu->addAction(visionModeName(mode));
+        action->setCheckable(true);
+        action->setChecked(visionMode_ == mode);
+        action->setData(static_cast<int>(mode));
+        group->addAction(action);
+        connect(action, &QAction::triggered, this, [this, mode]() { setVisionMode(mode); });
+    }
+
+    void setVisionMode(VisionMode mode) {
+        visionMode_ = mode;
+        QSettings settings;
+        settings.setValue("visionMode", static_cast<int>(mode));
+        applyVisionMode();
+    }
+
+    // The whole capture is filtered once per mode and pick, every overlay
+    // shows a view of its screen in it; toggling back is free.
+    void applyVisionMode() {
+        if (activeOverlays_.isEmpty()) return;
+        QImage filtered;
+        if (visionMode_ != VisionMode::Normal && !captureBuffer_.isNull()) {
+            QImage& cached = visionCache_[visionMode_];
+            if (cached.isNull()) {
+                QElapsedTimer timer;
+                timer.start();
+                applyVisionFilter(captureBuffer_, cached, visionMode_);
+                qInfo().noquote() << QString("vision preview %1: %2 ms")
+                                         .arg(visionModeName(visionMode_))
+                                         .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2);
+            }
+            filtered = cached;
+        }
         for (ColorPickerOverlay* overlay : activeOverlays_) {
-            overlay->close();
-            overlay->deleteLater();
+            const QRect geo = overlay->overlayScreen()->geometry().translated(-captureGeometry_.topLeft());
+            overlay->setVisionView(filtered.isNull() ? QImage() : captureView(filtered, geo), visionMode_);
         }
-        activeOverlays_.clear();
     }
 
-    void onColorPicked(const QString& colorText) {
-        trayIcon_->showMessage("Color Picked!",
-                               QString("Copied to clipboard: %1").arg(colorText),
+    void rebuildSessionMenu() {
+        sessionMenu_->clear();
+        QAction* saveAction = sessionMenu_->addAction("Save Sessions");
+        saveAction->setCheckable(true);
+        saveAction->setChecked(saveSessions_);
+        connect(saveAction, &QAction::toggled, this, [this](bool checked) {
+            saveSessions_ = checked;
+            QSettings settings;
+            settings.setValue("saveSessions", checked);
+        });
+        sessionMenu_->addSeparator();
+
+        const QList<SessionInfo> sessions = sessions_->list();
+        if (sessions.isEmpty()) {
+            sessionMenu_->addAction("No Saved Sessions")->setEnabled(false);
+            return;
+        }
+        for (const SessionInfo& info : sessions) {
+            QString text = info.time.toString("yyyy-MM-dd HH:mm:ss");
+            if (!info.picks.isEmpty()) {
+                // the latest pick, first line of a palette
+                text += QString("  %1").arg(info.picks.last().text.section('\n', 0, 0));
+                if (info.picks.size() > 1) text += QString(" (+%1)").arg(info.picks.size() - 1);
+            }
+            QAction* action = sessionMenu_->addAction(text);
+            const QString id = info.id;
+            connect(action, &QAction::triggered, this, [this, id]() { reopenSession(id); });
+        }
+    }
+
+    // Fresh captures with a pick go to disk when saving is on; picks made in
+    // a reopened session are added to its record either way.
+    void storeSession() {
+        const QList<SessionPick> picks = sessionPicks_;
+        SessionInfo info = reopenedSession_;
+        sessionPicks_.clear();
+        reopenedSession_ = SessionInfo();
+        if (picks.size() == info.picks.size() || captureBuffer_.isNull()) return;
+
+        if (!info.id.isEmpty()) {
+            info.picks = picks;
+            sessions_->updatePicks(info);
+            return;
+        }
+        if (!saveSessions_) return;
+        info.time = QDateTime::currentDateTime();
+        info.id = info.time.toString("yyyyMMdd-HHmmss-zzz");
+        info.geometry = captureGeometry_;
+        for (QScreen* screen : QGuiApplication::screens()) info.screens.append(screen->geometry());
+        info.picks = picks;
+        sessions_->save(captureBuffer_, info);
+    }
+
+    // The snapshot is mapped and decoded on every core straight into the
+    // capture buffer, then shown the way a fresh capture is.
+    void reopenSession(const QString& id) {
+        if (captureInFlight_) return;
+        TraceSpan span("reopenSession");
+        span.setDetail(id);
+        if (liveMagnifier_) liveMagnifier_->stop();
+        closeAllOverlays();
+
+        QElapsedTimer timer;
+        timer.start();
+        SessionInfo info;
+        if (!sessions_->load(id, captureBuffer_, &info)) {
+            trayIcon_->showMessage("Color Picker", "The session could not be read", QSystemTrayIcon::Warning, 3000);
+            return;
+        }
+        // overlays are per screen, the capture has to cover every one of them
+        for (QScreen* screen : QGuiApplication::screens()) {
+            if (!info.geometry.contains(screen->geometry())) {
+                trayIcon_->showMessage("Color Picker", "The session was saved with a different screen layout",
+                                       QSystemTrayIcon::Warning, 3000);
+                if (!warmPool_) captureBuffer_ = QImage();
+                return;
+            }
+        }
+        qInfo().noquote() << QString("session %1 loaded: %2 ms").arg(id).arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1);
+
+        sessionPicks_ = info.picks;
+        reopenedSession_ = info;
+        onCaptureReady(pickGeneration_, info.geometry, std::move(captureBuffer_));
+    }
+
+    void addNamedColorModeAction(QMenu* menu, QActionGroup* group, const QString& text, NamedColorMode mode) {
+        QAction* action = menu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(namedColorMode_ == mode);
+        group->addAction(action);
+        connect(action, &QAction::triggered, this, [this, mode]() {
+            namedColorMode_ = mode;
+            QSettings settings;
+            settings.setValue("namedColorMode", static_cast<int>(mode));
+        });
+    }
+
+    // parsed and indexed once, every overlay shares the index
+    bool loadNamedColors(const QString& path) {
+        if (path.isEmpty()) return false;
+        QElapsedTimer timer;
+        timer.start();
+        QString error;
+        auto index = std::make_shared<const NamedColorIndex>(NamedColorIndex::load(path, &error));
+        if (index->isEmpty()) {
+            qWarning().noquote() << QString("named colors %1: %2").arg(path, error);
+            return false;
+        }
+        qInfo().noquote() << QString("named colors: %1 entries from %2 in %3 ms")
+                                 .arg(index->size())
+                                 .arg(path)
+                                 .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1);
+        namedColors_ = std::move(index);
+        return true;
+    }
+
+    void chooseNamedColors() {
+        QSettings settings;
+        QString path = QFileDialog::getOpenFileName(nullptr, "Load Named Colors",
+                                                    settings.value("namedColorsFile").toString(),
+                                                    "Palettes (*.txt *.gpl *.css *.json);;All Files (*)");
+        if (path.isEmpty()) return;
+        if (!loadNamedColors(path)) {
+            trayIcon_->showMessage("Named Colors", QString("No colors found in %1").arg(path),
+                                   QSystemTrayIcon::Warning, 3000);
+            return;
+        }
+        settings.setValue("namedColorsFile", path);
+        trayIcon_->showMessage("Named Colors", QString("Loaded %1 named colors").arg(namedColors_->size()),
                                QSystemTrayIcon::Information, 2000);
     }
 
-   private:
+    void addBackendAction(QMenu* menu, QActionGroup* group, const QString& text, const QString& name, bool available) {
+        QAction* action = menu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(captureBackendName_ == name);
+        action->setEnabled(available);
+        group->addAction(action);
+        connect(action, &QAction::triggered, this, [this, name]() {
+            captureBackendName_ = name;
+            QSettings settings;
+            settings.setValue("captureBackend", name);
+            if (pixelWatcher_) pixelWatcher_->setCaptureOrder(captureOrder(captureBackends_, captureBackendName_));
+        });
+    }
+
     QString getAutostartPath() const {
         QString configHome = qEnvironmentVariable("XDG_CONFIG_HOME");
         if (configHome.isEmpty()) {
@@ -507,22 +970,343 @@ class ColorPickerApp : public QObject {
     }
 
     QSystemTrayIcon* trayIcon_;
+    FrameScheduler* frameScheduler_;
+    CaptureBackendList captureBackends_;
+    QString captureBackendName_;  // "auto" or a backend name
+    QImage captureBuffer_;  // whole virtual desktop, overlays hold views into it
+    QRect captureGeometry_;  // what captureBuffer_ covers
+    VisionMode visionMode_ = VisionMode::Normal;
+    QMap<VisionMode, QImage> visionCache_;  // filtered copies of this pick's capture
+    QActionGroup* visionGroup_;
+    QMenu* sessionMenu_;
+    std::unique_ptr<SessionStore> sessions_;
+    bool saveSessions_ = false;
+    QList<SessionPick> sessionPicks_;  // made during this pick, a reopened session's earlier ones first
+    SessionInfo reopenedSession_;  // id empty for a fresh capture
+    QMap<QScreen*, ColorPickerOverlay*> warmOverlays_;
+    bool warmPool_ = false;
+    int sampleSize_ = 1;
+    int paletteSize_ = 5;  // dominant colors copied for a drag selection
+    int zoom_ = 12;
+    int magnifierSize_ = 150;  // side in pixels
+    std::shared_ptr<const NamedColorIndex> namedColors_;  // null without a palette
+    NamedColorMode namedColorMode_ = NamedColorMode::Show;
+    quint64 pickGeneration_ = 0;  // bumped on close, stale async results are dropped
+    bool captureInFlight_ = false;
+    bool socketCaptureInFlight_ = false;
+    void (ColorPickerApp::*deferredStart_)() = nullptr;  // a pick started during a socket capture
     QList<ColorPickerOverlay*> activeOverlays_;
+    ColorPickerOverlay* integralOverlay_ = nullptr;  // holds this pick's summed-area table
+    LiveMagnifier* liveMagnifier_ = nullptr;  // created on the first live pick, then reused
+    PickServer* pickServer_ = nullptr;  // only with --listen
+    PixelWatcher* pixelWatcher_ = nullptr;  // created by the first watch
+    QSet<int> commandLineWatches_;  // the rest belong to socket clients
+    int watchIntervalMs_ = 100;
+    QImage serverBuffer_;  // whole desktop for socket samples no single screen holds
+    QList<QJsonObject> history_;  // most recent first, at most kHistorySize
+    bool showHud_ = false;
     ColorFormat currentFormat_;
 };
 
+// Headless sampling: decode (or map) the image once, then answer coordinates
+// from --at, a --coords file or stdin with one formatted color per line.
+class HeadlessSampler {
+   public:
+    HeadlessSampler(const QImage& image, ColorFormat format, int sampleSize)
+        : image_(image), sampler_(image_), format_(format), sampleSize_(sampleSize) {
+        if (sampleSize_ > 1) integral_ = IntegralImage(image_);
+        out_.reserve(kFlushBytes + 256);
+    }
+
+    ~HeadlessSampler() { flush(); }
+
+    // out-of-range points still produce a line (empty) so output stays aligned with input
+    void sample(int x, int y) {
+        QPoint pos(x, y);
+        if (sampler_.contains(pos)) {
+            QRgb pixel = sampler_.pixel(pos);
+            if (sampleSize_ > 1) {
+                const int radius = sampleSize_ / 2;
+                QRect box = QRect(x - radius, y - radius, sampleSize_, sampleSize_).intersected(sampler_.rect());
+                pixel = integral_.average(box);
+            }
+            char buffer[ColorFormatter::kMaxLength];
+            out_.append(buffer, formatter_.format(pixel, format_, buffer));
+        } else {
+            ++outOfRange_;
+        }
+        out_ += '\n';
+        if (out_.size() >= kFlushBytes) flush();
+    }
+
+    // "x,y" / "x y" / "x;y" per line; blank lines and # comments are skipped.
+    // Returns the number of bytes consumed, a trailing partial line is left over.
+    qsizetype feed(const char* data, qsizetype size, bool final) {
+        qsizetype lineStart = 0;
+        for (qsizetype i = 0; i < size; ++i) {
+            if (data[i] != '\n') continue;
+            parseLine(data + lineStart, i - lineStart);
+            lineStart = i + 1;
+        }
+        if (final && lineStart < size) {
+            parseLine(data + lineStart, size - lineStart);
+            lineStart = size;
+        }
+        return lineStart;
+    }
+
+    void flush() {
+        if (out_.isEmpty()) return;
+        fwrite(out_.constData(), 1, size_t(out_.size()), stdout);
+        fflush(stdout);
+        out_.clear();
+    }
+
+    qint64 outOfRange() const { return outOfRange_; }
+    qint64 malformed() const { return malformed_; }
+
+   private:
+    void parseLine(const char* p, qsizetype size) {
+        const char* end = p + size;
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        if (p == end || *p == '#') return;
+
+        int coords[2];
+        for (int& value : coords) {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == ',' || *p == ';')) ++p;
+            bool negative = p < end && *p == '-';
+            if (negative) ++p;
+            if (p == end || *p < '0' || *p > '9') {
+                ++malformed_;
+                out_ += '\n';
+                return;
+            }
+            // 64-bit with a cap, so no run of digits can overflow
+            qint64 number = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                number = qMin(number * 10 + (*p++ - '0'), qint64(INT_MAX) + 1);
+            }
+            if (negative) number = -number;
+            if (number < INT_MIN || number > INT_MAX) {
+                ++malformed_;
+                out_ += '\n';
+                return;
+            }
+            value = int(number);
+        }
+        sample(coords[0], coords[1]);
+    }
+
+    static constexpr qsizetype kFlushBytes = 1 << 16;
+
+    QImage image_;
+    PixelSampler sampler_;
+    IntegralImage integral_;
+    const ColorFormatter& formatter_ = ColorFormatter::instance();
+    ColorFormat format_;
+    int sampleSize_;
+    QByteArray out_;
+    qint64 outOfRange_ = 0;
+    qint64 malformed_ = 0;
+};
+
+int runHeadless(QCoreApplication& app) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless color sampling");
+    parser.addHelpOption();
+    QCommandLineOption imageOption("image", "Image to sample.", "file");
+    QCommandLineOption atOption("at", "Sample the pixel at x,y (repeatable).", "x,y");
+    QCommandLineOption formatOption("format", "html, hex, delphi, vb, rgba, rgb, rgbf, hsv, hsl, lab, oklab, oklch or cmyk.", "name", "hex");
+    QCommandLineOption averageOption("average", "Average over an NxN box (1-101).", "N", "1");
+    QCommandLineOption batchOption("batch", "Read x,y lines from stdin, write one color per line.");
+    QCommandLineOption coordsOption("coords", "Read x,y lines from <file>, write one color per line.", "file");
+    parser.addOptions({imageOption, atOption, formatOption, averageOption, batchOption, coordsOption});
+    parser.process(app);
+
+    ColorFormat format;
+    if (!parseColorFormat(parser.value(formatOption), &format)) {
+        fprintf(stderr, "unknown format: %s\n", qPrintable(parser.value(formatOption)));
+        return 2;
+    }
+    bool ok = false;
+    int sampleSize = parser.value(averageOption).toInt(&ok);
+    if (!ok || sampleSize < 1 || sampleSize > 101) {
+        fprintf(stderr, "--average must be between 1 and 101\n");
+        return 2;
+    }
+
+    // decode straight from a mapping of the file, no intermediate read buffer
+    QFile imageFile(parser.value(imageOption));
+    if (!imageFile.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "cannot open %s\n", qPrintable(imageFile.fileName()));
+        return 1;
+    }
+    QImage image;
+    if (uchar* mapped = imageFile.map(0, imageFile.size())) {
+        image.loadFromData(mapped, int(imageFile.size()));
+        imageFile.unmap(mapped);
+    } else {
+        image.load(&imageFile, nullptr);
+    }
+    if (image.isNull()) {
+        fprintf(stderr, "cannot decode %s\n", qPrintable(imageFile.fileName()));
+        return 1;
+    }
+
+    HeadlessSampler sampler(image.convertToFormat(QImage::Format_ARGB32), format, sampleSize);
+
+    for (const QString& at : parser.values(atOption)) {
+        QByteArray line = at.toLatin1();
+        sampler.feed(line.constData(), line.size(), true);
+    }
+
+    if (parser.isSet(coordsOption)) {
+        QFile coords(parser.value(coordsOption));
+        if (!coords.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "cannot open %s\n", qPrintable(coords.fileName()));
+            return 1;
+        }
+        if (coords.size() > 0) {
+            if (const uchar* mapped = coords.map(0, coords.size())) {
+                sampler.feed(reinterpret_cast<const char*>(mapped), coords.size(), true);
+            } else {
+                QByteArray all = coords.readAll();
+                sampler.feed(all.constData(), all.size(), true);
+            }
+        }
+    }
+
+    if (parser.isSet(batchOption)) {
+        // big chunks, the unfinished last line is carried into the next one
+        QByteArray chunk(1 << 20, Qt::Uninitialized);
+        qsizetype pending = 0;
+        for (;;) {
+            size_t n = fread(chunk.data() + pending, 1, size_t(chunk.size() - pending), stdin);
+            qsizetype size = pending + qsizetype(n);
+            bool final = n == 0;
+            qsizetype used = sampler.feed(chunk.constData(), size, final);
+            if (final) break;
+            pending = size - used;
+            memmove(chunk.data(), chunk.constData() + used, size_t(pending));
+            if (pending == chunk.size()) chunk.resize(chunk.size() * 2);
+        }
+    }
+
+    sampler.flush();
+    if (sampler.outOfRange() > 0 || sampler.malformed() > 0) {
+        fprintf(stderr, "%lld out of range, %lld malformed\n", sampler.outOfRange(), sampler.malformed());
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    // headless sampling needs no display, tray or widgets (works with QT_QPA_PLATFORM=offscreen)
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--image") == 0 || qstrncmp(argv[i], "--image=", 8) == 0) {
+            QCoreApplication app(argc, argv);
+            return runHeadless(app);
+        }
+    }
+
     QApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription("System tray color picker\n"
+                                     "Run with --image <file> --help for headless sampling.");
+    parser.addHelpOption();
+    QCommandLineOption backendOption("capture-backend",
+                                     "Screen capture backend: auto, xshm, grabwindow or spectacle.",
+                                     "name", qEnvironmentVariable("COLORPICKER_CAPTURE_BACKEND"));
+    QCommandLineOption captureToOption("capture-to",
+                                       "Capture the virtual desktop once into <file> and exit (no tray needed).",
+                                       "file");
+    QCommandLineOption traceOption("trace",
+                                   "Record spans into <file> as Chrome trace-event JSON; new events are appended after every pick.",
+                                   "file", qEnvironmentVariable("COLORPICKER_TRACE"));
+    QCommandLineOption namedColorsOption("named-colors",
+                                         "Show the nearest entry of the palette in <file> in the magnifier.",
+                                         "file", qEnvironmentVariable("COLORPICKER_NAMED_COLORS"));
+    QCommandLineOption hudOption("hud", "Show frame times (p50/p99) and dropped frames on the overlay.");
+    QCommandLineOption listenOption("listen", "Answer pick, sample and history requests on a local socket.");
+    QCommandLineOption socketOption("socket",
+                                    "Socket path for --listen (implies it), default $XDG_RUNTIME_DIR/colorpicker.sock.",
+                                    "path", qEnvironmentVariable("COLORPICKER_SOCKET"));
+    QCommandLineOption watchOption("watch",
+                                   "Report when the pixel at x,y (or the average of the w x h region) changes "
+                                   "color, on stdout and in the tray (repeatable).",
+                                   "x,y[,w,h]");
+    QCommandLineOption watchThresholdOption("watch-threshold",
+                                            "OKLab distance that counts as a change for --watch.", "distance", "0.02");
+    QCommandLineOption watchIntervalOption("watch-interval", "Shortest time between two grabs of watched pixels.",
+                                           "ms", "100");
+    parser.addOption(backendOption);
+    parser.addOption(captureToOption);
+    parser.addOption(traceOption);
+    parser.addOption(namedColorsOption);
+    parser.addOption(hudOption);
+    parser.addOption(listenOption);
+    parser.addOption(socketOption);
+    parser.addOption(watchOption);
+    parser.addOption(watchThresholdOption);
+    parser.addOption(watchIntervalOption);
+    parser.process(app);
+
+    if (!parser.value(traceOption).isEmpty()) {
+        Tracer::instance().start(parser.value(traceOption));
+    }
+
+    if (parser.isSet(captureToOption)) {
+        CaptureBackendList backends = createCaptureBackends();
+        QImage capture = captureVirtualDesktop(backends, parser.value(backendOption), virtualDesktopGeometry());
+        Tracer::instance().flush();
+        return !capture.isNull() && capture.save(parser.value(captureToOption)) ? 0 : 1;
+    }
+
+    // parsed up front so a typo fails before the tray appears
+    std::vector<QRect> watches;
+    for (const QString& value : parser.values(watchOption)) {
+        const QStringList parts = value.split(',');
+        int numbers[4] = {0, 0, 1, 1};
+        bool ok = parts.size() == 2 || parts.size() == 4;
+        for (int i = 0; ok && i < parts.size(); ++i) numbers[i] = parts[i].trimmed().toInt(&ok);
+        if (!ok || numbers[2] < 1 || numbers[3] < 1) {
+            fprintf(stderr, "--watch expects x,y or x,y,w,h: %s\n", qPrintable(value));
+            return 2;
+        }
+        const QRect area(numbers[0], numbers[1], numbers[2], numbers[3]);
+        if (!watchAreaOnScreen(area)) {
+            fprintf(stderr, "--watch area is not on one screen: %s\n", qPrintable(value));
+            return 2;
+        }
+        watches.push_back(area);
+    }
+    bool thresholdOk = false;
+    const float watchThreshold = parser.value(watchThresholdOption).toFloat(&thresholdOk);
+    bool intervalOk = false;
+    const int watchInterval = parser.value(watchIntervalOption).toInt(&intervalOk);
+    if (!thresholdOk || watchThreshold < 0 || !intervalOk || watchInterval < 10) {
+        fprintf(stderr, "--watch-threshold must not be negative, --watch-interval must be at least 10 ms\n");
+        return 2;
+    }
+
     if (!QSystemTrayIcon::isSystemTrayAvailable()) {
         QMessageBox::critical(nullptr, "Color Picker",
                               "System tray is not available!");
         return 1;
     }
 
-    ColorPickerApp pickerApp;
+    const bool showHud = parser.isSet(hudOption) || qEnvironmentVariableIsSet("COLORPICKER_HUD");
+    ColorPickerApp pickerApp(parser.value(backendOption), showHud, parser.value(namedColorsOption));
+    if (parser.isSet(listenOption) || !parser.value(socketOption).isEmpty()) {
+        const QString socketPath = parser.value(socketOption);
+        pickerApp.listen(socketPath.isEmpty() ? PickServer::defaultSocketPath() : socketPath);
+    }
+    pickerApp.setWatchInterval(watchInterval);
+    for (const QRect& area : watches) pickerApp.watch(area, watchThreshold);
 
-    return app.exec();
+    const int result = app.exec();
+    Tracer::instance().flush();
+    return result;
 }
 
-#include "main.moc"
\ No newline at end of file
+#include "main.moc"
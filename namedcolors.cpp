@@ -0,0 +1,220 @@
+#include "namedcolors.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QStringList>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// "#RGB" or "#RRGGBB"
+bool parseHex(const QString& token, QRgb* color) {
+    if (!token.startsWith('#') || (token.size() != 4 && token.size() != 7)) return false;
+    for (int i = 1; i < token.size(); ++i) {
+        if (!isxdigit(token[i].unicode())) return false;
+    }
+    const uint value = token.mid(1).toUInt(nullptr, 16);
+    if (token.size() == 4) {
+        *color = qRgb(int(value >> 8 & 0xf) * 17, int(value >> 4 & 0xf) * 17, int(value & 0xf) * 17);
+    } else {
+        *color = qRgb(int(value >> 16 & 0xff), int(value >> 8 & 0xff), int(value & 0xff));
+    }
+    return true;
+}
+
+bool parseLine(const QString& line, NamedColor* entry) {
+    static const QRegularExpression separators("[\\s,;:=\"']+");
+    const QString trimmed = line.trimmed();
+    if (trimmed.isEmpty() || trimmed.startsWith("//") || trimmed.startsWith('!')) return false;
+
+    QStringList tokens = trimmed.split(separators, Qt::SkipEmptyParts);
+    if (tokens.isEmpty()) return false;
+
+    // GIMP palette / X11 rgb.txt: R G B name
+    if (tokens.size() >= 4) {
+        int channels[3];
+        bool numeric = true;
+        for (int c = 0; c < 3 && numeric; ++c) {
+            channels[c] = tokens[c].toInt(&numeric);
+            numeric = numeric && channels[c] >= 0 && channels[c] <= 255;
+        }
+        if (numeric) {
+            entry->color = qRgb(channels[0], channels[1], channels[2]);
+            entry->name = tokens.mid(3).join(' ');
+            return true;
+        }
+    }
+
+    // the first hex color on the line, everything else is the name; a
+    // leading '#' that is not a color starts a comment
+    for (int i = 0; i < tokens.size(); ++i) {
+        if (!parseHex(tokens[i], &entry->color)) {
+            if (i == 0 && tokens[i].startsWith('#')) return false;
+            continue;
+        }
+        tokens.removeAt(i);
+        entry->name = tokens.join(' ');
+        return !entry->name.isEmpty();
+    }
+    return false;
+}
+
+// plain "key": "#hex" pairs, token objects ({"$value": ...}, {"value": ...})
+// and arrays of {"name": ..., "hex": ...} records
+void collectJson(const QJsonValue& value, const QString& path, std::vector<NamedColor>& colors) {
+    QRgb color;
+    if (value.isString()) {
+        if (!path.isEmpty() && parseHex(value.toString(), &color)) colors.push_back({path, color});
+        return;
+    }
+    if (value.isArray()) {
+        for (const QJsonValue& item : value.toArray()) collectJson(item, path, colors);
+        return;
+    }
+    if (!value.isObject()) return;
+
+    const QJsonObject object = value.toObject();
+    const QString name = object.value("name").toString(path);
+    for (const char* key : {"$value", "value", "hex", "color"}) {
+        if (parseHex(object.value(QLatin1String(key)).toString(), &color)) {
+            if (!name.isEmpty()) colors.push_back({name, color});
+            return;
+        }
+    }
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        collectJson(it.value(), path.isEmpty() ? it.key() : path + '.' + it.key(), colors);
+    }
+}
+
+float distance2(const float* a, const float* b) {
+    const float d0 = a[0] - b[0];
+    const float d1 = a[1] - b[1];
+    const float d2 = a[2] - b[2];
+    return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+}  // namespace
+
+NamedColorIndex::NamedColorIndex(std::vector<NamedColor> colors) : colors_(std::move(colors)) {
+    const ColorFormatter& formatter = ColorFormatter::instance();
+    nodes_.resize(colors_.size());
+    for (size_t i = 0; i < colors_.size(); ++i) {
+        const QRgb color = colors_[i].color;
+        formatter.toOklab(qRed(color), qGreen(color), qBlue(color), nodes_[i].lab);
+        nodes_[i].axis = 0;
+        nodes_[i].entry = int(i);
+    }
+    build(0, int(nodes_.size()));
+}
+
+NamedColorIndex NamedColorIndex::load(const QString& path, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) *error = file.errorString();
+        return NamedColorIndex();
+    }
+    const QByteArray data = file.readAll();
+
+    std::vector<NamedColor> colors;
+    const QByteArray start = data.trimmed().left(1);
+    if (start == "{" || start == "[") {
+        QJsonParseError parseError;
+        const QJsonDocument document = QJsonDocument::fromJson(data, &parseError);
+        if (document.isNull()) {
+            if (error) *error = parseError.errorString();
+            return NamedColorIndex();
+        }
+        collectJson(document.isArray() ? QJsonValue(document.array()) : QJsonValue(document.object()), QString(),
+                    colors);
+    } else {
+        NamedColor entry;
+        for (const QString& line : QString::fromUtf8(data).split('\n')) {
+            if (parseLine(line, &entry)) colors.push_back(entry);
+        }
+    }
+
+    if (colors.empty() && error) *error = "no colors found";
+    return NamedColorIndex(std::move(colors));
+}
+
+void NamedColorIndex::visit(const Node& node, const float* lab, int* best, float* bestDistance) {
+    const float distance = distance2(node.lab, lab);
+    if (distance < *bestDistance || (distance == *bestDistance && node.entry < *best)) {
+        *bestDistance = distance;
+        *best = node.entry;
+    }
+}
+
+QString formatPickedColor(QRgb color, ColorFormat format, const NamedColorIndex* namedColors, NamedColorMode mode) {
+    const int index = namedColors && mode != NamedColorMode::Show ? namedColors->nearest(color) : -1;
+    if (index < 0) return formatColor(QColor::fromRgb(color), format);
+    if (mode == NamedColorMode::CopyName) return namedColors->at(index).name;
+    return formatColor(QColor::fromRgb(namedColors->at(index).color), format);
+}
+
+int NamedColorIndex::nearest(QRgb color, float* distance) const {
+    if (nodes_.empty()) return -1;
+    float lab[3];
+    ColorFormatter::instance().toOklab(qRed(color), qGreen(color), qBlue(color), lab);
+
+    int best = -1;
+    float bestDistance = std::numeric_limits<float>::max();
+    search(0, int(nodes_.size()), lab, &best, &bestDistance);
+    if (distance) *distance = std::sqrt(bestDistance);
+    return best;
+}
+
+// splits on the axis with the widest spread in this range, down to leaves
+// small enough that a linear scan beats descending further
+void NamedColorIndex::build(int begin, int end) {
+    if (end - begin <= kLeafSize) return;
+
+    float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                   std::numeric_limits<float>::max()};
+    float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                   std::numeric_limits<float>::lowest()};
+    for (int i = begin; i < end; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = std::min(lo[c], nodes_[i].lab[c]);
+            hi[c] = std::max(hi[c], nodes_[i].lab[c]);
+        }
+    }
+    int axis = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (hi[c] - lo[c] > hi[axis] - lo[axis]) axis = c;
+    }
+
+    const int mid = begin + (end - begin) / 2;
+    std::nth_element(nodes_.begin() + begin, nodes_.begin() + mid, nodes_.begin() + end,
+                     [axis](const Node& a, const Node& b) { return a.lab[axis] < b.lab[axis]; });
+    nodes_[mid].axis = axis;
+    build(begin, mid);
+    build(mid + 1, end);
+}
+
+// nearer half first, the far half only when the split plane is closer than the
+// best match so far; equal distances go to the entry listed first
+void NamedColorIndex::search(int begin, int end, const float* lab, int* best, float* bestDistance) const {
+    if (end - begin <= kLeafSize) {
+        for (int i = begin; i < end; ++i) visit(nodes_[i], lab, best, bestDistance);
+        return;
+    }
+    const int mid = begin + (end - begin) / 2;
+    const Node& node = nodes_[mid];
+    visit(node, lab, best, bestDistance);
+
+    const float offset = lab[node.axis] - node.lab[node.axis];
+    if (offset < 0) {
+        search(begin, mid, lab, best, bestDistance);
+        if (offset * offset <= *bestDistance) search(mid + 1, end, lab, best, bestDistance);
+    } else {
+        search(mid + 1, end, lab, best, bestDistance);
+        if (offset * offset <= *bestDistance) search(begin, mid, lab, best, bestDistance);
+    }
+}
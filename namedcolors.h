@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QRgb>
+#include <QString>
+#include <vector>
+
+#include "colorformat.h"
+
+// what a pick copies while a named-color palette is loaded
+enum class NamedColorMode {
+    Show,       // magnifier shows the nearest name, the picked color is copied as is
+    SnapColor,  // copy the nearest entry's color in the current format
+    CopyName    // copy the nearest entry's name
+};
+
+struct NamedColor {
+    QString name;
+    QRgb color;
+};
+
+// Nearest-name lookup over a user palette (design tokens, large named-color
+// lists). The entries sit in a k-d tree over OKLab that is built once on load,
+// so a query visits a few dozen nodes instead of every entry.
+class NamedColorIndex {
+   public:
+    NamedColorIndex() = default;
+    explicit NamedColorIndex(std::vector<NamedColor> colors);
+
+    // One color per line: "name #RRGGBB", "#RRGGBB name", CSS "--token: #RGB;"
+    // or GIMP .gpl "R G B name". A file starting with '{' is read as JSON
+    // design tokens, named by their dotted key path.
+    static NamedColorIndex load(const QString& path, QString* error = nullptr);
+
+    bool isEmpty() const { return colors_.empty(); }
+    int size() const { return int(colors_.size()); }
+    const NamedColor& at(int index) const { return colors_[index]; }
+
+    // entry closest to color in OKLab, -1 when empty; distance is the
+    // Euclidean OKLab distance (about 0.02 is a just noticeable difference)
+    int nearest(QRgb color, float* distance = nullptr) const;
+
+   private:
+    struct Node {
+        float lab[3];
+        int axis;  // split axis of the subtree this node is the middle of
+        int entry;
+    };
+
+    static constexpr int kLeafSize = 8;
+
+    void build(int begin, int end);
+    void search(int begin, int end, const float* lab, int* best, float* bestDistance) const;
+    static void visit(const Node& node, const float* lab, int* best, float* bestDistance);
+
+    std::vector<NamedColor> colors_;
+    std::vector<Node> nodes_;  // implicit tree: each range is split at its middle, leaves are scanned
+};
+
+// a picked color as it is copied: formatted, or snapped to / named by the
+// nearest entry of namedColors (null for none)
+QString formatPickedColor(QRgb color, ColorFormat format, const NamedColorIndex* namedColors, NamedColorMode mode);
@@ -0,0 +1,773 @@
+#pragma once
+
+#include <QApplication>
+#include <QClipboard>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QPointer>
+#include <QScreen>
+#include <QTimer>
+#include <QWheelEvent>
+#include <QWidget>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <array>
+#include <memory>
+
+#include "colorformat.h"
+#include "magnifier.h"
+#include "namedcolors.h"
+#include "palette.h"
+#include "sampling.h"
+#include "trace.h"
+#include "visionfilter.h"
+
+// one display refresh, the time budget of a frame
+inline qint64 refreshPeriodNs(QScreen* screen) {
+    qreal hz = screen ? screen->refreshRate() : 60.0;
+    if (hz < 1.0) hz = 60.0;
+    return qint64(1e9 / hz);
+}
+
+// per-frame render cost, enable the summary with COLORPICKER_FRAME_STATS=1.
+// Percentiles cover the last kWindow frames, which is what the HUD shows.
+class FrameStats {
+   public:
+    static constexpr int kWindow = 240;
+
+    // frames over budgetNs (one refresh period) count as dropped
+    void record(qint64 nsecs, qint64 budgetNs = 0) {
+        recent_[frames_ % kWindow] = nsecs;
+        ++frames_;
+        totalNs_ += nsecs;
+        maxNs_ = qMax(maxNs_, nsecs);
+        if (budgetNs > 0 && nsecs > budgetNs) ++dropped_;
+    }
+
+    qint64 frames() const { return frames_; }
+    qint64 dropped() const { return dropped_; }
+
+    // p in [0, 1]
+    qint64 percentile(double p) const {
+        const int count = int(qMin<qint64>(frames_, kWindow));
+        if (count == 0) return 0;
+        std::array<qint64, kWindow> sorted = recent_;
+        const int index = qMin(count - 1, int(p * count));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.begin() + count);
+        return sorted[index];
+    }
+
+    void report(const QString& label) const {
+        if (frames_ == 0 || !qEnvironmentVariableIsSet("COLORPICKER_FRAME_STATS")) return;
+        qInfo().noquote() << QString("%1: %2 frames, avg %3 ms, max %4 ms, p50 %5 ms, p99 %6 ms, dropped %7")
+                                 .arg(label)
+                                 .arg(frames_)
+                                 .arg(totalNs_ / 1e6 / frames_, 0, 'f', 3)
+                                 .arg(maxNs_ / 1e6, 0, 'f', 3)
+                                 .arg(percentile(0.50) / 1e6, 0, 'f', 3)
+                                 .arg(percentile(0.99) / 1e6, 0, 'f', 3)
+                                 .arg(dropped_);
+    }
+
+   private:
+    std::array<qint64, kWindow> recent_{};
+    qint64 frames_ = 0;
+    qint64 totalNs_ = 0;
+    qint64 maxNs_ = 0;
+    qint64 dropped_ = 0;
+};
+
+// Color info box under the magnifier: a swatch, the color in the selected
+// format and, with a palette loaded, the nearest named color. The text is
+// only rebuilt when the color changes.
+class ColorReadout {
+   public:
+    void reset() { text_.clear(); }
+
+    void update(QRgb color, ColorFormat format, const NamedColorIndex* namedColors) {
+        if (!text_.isEmpty() && color == color_) return;
+        color_ = color;
+        text_ = formatColor(QColor::fromRgba(color), format);
+        name_.clear();
+        float distance = 0;
+        const int index = namedColors ? namedColors->nearest(color, &distance) : -1;
+        if (index >= 0) {
+            // OKLab distance scaled by 100, the usual delta E convention for it
+            name_ = QString("%1  \u0394E %2").arg(namedColors->at(index).name).arg(distance * 100, 0, 'f', 1);
+        }
+    }
+
+    void draw(QPainter& painter, const QRect& textRect) const {
+        painter.fillRect(textRect, QColor(0, 0, 0, 200));
+
+        // Draw color preview square
+        int squareSize = 30;
+        int squarePadding = 10;
+        QRect colorSquare(textRect.left() + squarePadding,
+                          textRect.top() + (textRect.height() - squareSize) / 2,
+                          squareSize, squareSize);
+
+        // Fill with the actual color
+        painter.fillRect(colorSquare, QColor::fromRgba(color_));
+
+        // Draw white border around the square
+        painter.setPen(QPen(Qt::white, 2));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(colorSquare);
+
+        // Draw text next to the color square
+        painter.setPen(Qt::white);
+        QRect textOnlyRect(colorSquare.right() + squarePadding, textRect.top(),
+                           textRect.width() - colorSquare.width() - squarePadding * 3, textRect.height());
+        if (name_.isEmpty()) {
+            painter.drawText(textOnlyRect, Qt::AlignLeft | Qt::AlignVCenter, text_);
+            return;
+        }
+
+        // value on top, nearest name below it
+        const int half = textOnlyRect.height() / 2;
+        painter.drawText(textOnlyRect.adjusted(0, 0, 0, -half), Qt::AlignLeft | Qt::AlignBottom, text_);
+        painter.setPen(QColor(200, 200, 200));
+        painter.drawText(textOnlyRect.adjusted(0, half, 0, 0), Qt::AlignLeft | Qt::AlignTop,
+                         painter.fontMetrics().elidedText(name_, Qt::ElideRight, textOnlyRect.width()));
+    }
+
+   private:
+    QRgb color_ = 0;
+    QString text_;
+    QString name_;  // empty without a palette
+};
+
+class ColorPickerOverlay : public QWidget {
+    Q_OBJECT
+
+   public:
+    explicit ColorPickerOverlay(QScreen* screen)
+        : screen_(screen), colorFormat_(ColorFormat::HTML), zoomFactor_(12), lastCursor_(-1000, -1000) {
+        setWindowFlags(Qt::FramelessWindowHint |
+                       Qt::WindowStaysOnTopHint |
+                       Qt::Tool |
+                       Qt::BypassWindowManagerHint);
+        setAutoFillBackground(false);
+        setAttribute(Qt::WA_OpaquePaintEvent);
+        setAttribute(Qt::WA_NoSystemBackground);
+        setMouseTracking(true);
+        setCursor(Qt::CrossCursor);
+
+        // Set geometry to match this screen
+        setGeometry(screen->geometry());
+
+        connect(&paletteWatcher_, &QFutureWatcher<std::vector<PaletteColor>>::finished, this, [this]() {
+            // the drag ended while this preview was running
+            if (!selection_.isValid()) return;
+            palette_ = paletteWatcher_.result();
+            update(paletteRect(selection_));
+            if (previewPending_) requestPreview();
+        });
+    }
+
+    ~ColorPickerOverlay() {
+        // a preview job still reads the capture
+        paletteWatcher_.waitForFinished();
+        // Explicitly clear the capture to free memory immediately
+        sampler_ = PixelSampler();
+        displaySampler_ = PixelSampler();
+        screenshot_ = QImage();
+        display_ = QImage();
+    }
+
+    QScreen* overlayScreen() const { return screen_; }
+
+    // a view into the shared capture buffer (or a standalone placeholder), RGB32
+    void setScreenshot(const QImage& screenshot) {
+        sampler_ = PixelSampler();
+        displaySampler_ = PixelSampler();
+        tileCache_.setSource(PixelSampler());
+        display_ = QImage();
+        screenshot_ = screenshot;
+    }
+
+    // buffer is filled, reset per-pick state before showing
+    void beginPick(ColorFormat format, int sampleSize) {
+        sampler_ = PixelSampler(screenshot_);
+        display_ = screenshot_;
+        displaySampler_ = sampler_;
+        tileCache_.setSource(displaySampler_);
+        visionMode_ = VisionMode::Normal;
+        colorFormat_ = format;
+        sampleSize_ = sampleSize;
+        readout_.reset();
+        clearSelection();
+        lastCursor_ = QPoint(-1000, -1000);
+        dirtyRect_ = QRect();
+        frameBudgetNs_ = refreshPeriodNs(screen_);
+        // closed by the first paint after the overlay is shown
+        shownAtNs_ = Tracer::instance().isEnabled() ? Tracer::instance().now() : -1;
+    }
+
+    // zoom factor (kMinZoom to kMaxZoom) and magnifier side in pixels, shrunk
+    // to what the screen holds; the wheel and +/- change the zoom during a pick
+    void setMagnifier(int zoom, int size) {
+        zoomFactor_ = qBound(kMinZoom, zoom, kMaxZoom);
+        magnifierSize_ = size;
+    }
+
+    // frame-time HUD in the top-left corner
+    void setHudEnabled(bool enabled) { hudEnabled_ = enabled; }
+
+    // number of dominant colors a drag selection copies
+    void setPaletteSize(int size) { paletteSize_ = size; }
+
+    // nearest-name readout and clipboard snapping, null for none
+    void setNamedColors(std::shared_ptr<const NamedColorIndex> namedColors, NamedColorMode mode) {
+        namedColors_ = std::move(namedColors);
+        namedColorMode_ = mode;
+        readout_.reset();
+    }
+
+    // drops the view so the shared capture buffer can be released or refilled
+    void endPick() {
+        frameStats_.report(QString("overlay %1").arg(screen_->name()));
+        frameStats_ = FrameStats();
+        pendingFrameNs_ = 0;
+        shownAtNs_ = -1;
+        paletteWatcher_.waitForFinished();
+        clearSelection();
+        sampler_ = PixelSampler();
+        displaySampler_ = PixelSampler();
+        tileCache_.setSource(PixelSampler());
+        screenshot_ = QImage();
+        display_ = QImage();
+        integral_.reset();
+    }
+
+    // What is painted and magnified: a view of this screen in a filtered copy
+    // of the capture, or the capture itself for Normal. Sampling and picks
+    // keep reading the real pixels.
+    void setVisionView(const QImage& view, VisionMode mode) {
+        display_ = mode == VisionMode::Normal || view.isNull() ? screenshot_ : view;
+        displaySampler_ = PixelSampler(display_);
+        tileCache_.setSource(displaySampler_);
+        visionMode_ = mode;
+        update();
+    }
+
+    // summed-area table of this overlay's screen, null to average with a loop
+    void setIntegralImage(std::shared_ptr<const IntegralImage> integral) { integral_ = std::move(integral); }
+
+    // color under pos, averaged over the sample box (clipped to this screen)
+    QColor sampleColor(const QPoint& pos) const {
+        if (sampleSize_ <= 1) return sampler_.color(pos);
+
+        const int radius = sampleSize_ / 2;
+        QRect box = QRect(pos.x() - radius, pos.y() - radius, sampleSize_, sampleSize_).intersected(sampler_.rect());
+        if (integral_) return QColor::fromRgb(integral_->average(box));
+        return QColor::fromRgb(averageBox(sampler_, box));
+    }
+
+    // called by the frame scheduler, at most once per display refresh
+    void setCursorPosition(const QPoint& localCursor) {
+        if (localCursor == lastCursor_) return;
+        lastCursor_ = localCursor;
+        updateDisplay();
+    }
+
+    // Cursor left this screen - hide magnifier
+    void clearCursor() {
+        if (lastCursor_ == QPoint(-1000, -1000)) return;
+        lastCursor_ = QPoint(-1000, -1000);
+        // Repaint only the area the magnifier covered
+        update(dirtyRect_);
+        dirtyRect_ = QRect();
+    }
+
+    // The magnifier square, placed so it and the readout below it stay on
+    // screen: beside the cursor where both fit, on the other side where not,
+    // pushed back inside near the edges. Never larger than the screen allows.
+    QRect magnifierRect(const QPoint& cursor) const {
+        const int offset = 20;
+        const int size = qMax(1, qMin(magnifierSize_, qMin(width(), height() - kReadoutGap - kReadoutHeight)));
+        const int stackHeight = size + kReadoutGap + kReadoutHeight;
+
+        QPoint magnifierPos = cursor + QPoint(offset, offset);
+        if (magnifierPos.x() + size > width())
+            magnifierPos.setX(cursor.x() - size - offset);
+        if (magnifierPos.y() + stackHeight > height())
+            magnifierPos.setY(cursor.y() - stackHeight - offset);
+        magnifierPos.setX(qBound(0, magnifierPos.x(), width() - size));
+        magnifierPos.setY(qBound(0, magnifierPos.y(), height() - stackHeight));
+
+        return QRect(magnifierPos, QSize(size, size));
+    }
+
+    // color box under the magnifier
+    static QRect readoutRect(const QRect& magnifier) {
+        return QRect(magnifier.left(), magnifier.bottom() + 1 + kReadoutGap, magnifier.width(), kReadoutHeight);
+    }
+
+    // everything painted for one cursor position: magnifier, color box and crosshair
+    QRect overlayBounds(const QPoint& cursor) const {
+        QRect magnifier = magnifierRect(cursor);
+        QRect crosshair(cursor.x() - 10, cursor.y() - 10, 21, 21);
+
+        // pens are 2px wide and centered on the geometry
+        return magnifier.united(readoutRect(magnifier)).united(crosshair).adjusted(-2, -2, 2, 2);
+    }
+
+   protected:
+    void paintEvent(QPaintEvent* event) override {
+        TraceSpan span("paintEvent");
+        QElapsedTimer paintTimer;
+        paintTimer.start();
+
+        QPainter painter(this);
+        const QRegion region = event->region();
+
+        // Untouched screenshot (or its vision preview) straight from the source, only where invalidated
+        for (const QRect& rect : region) {
+            painter.drawImage(rect, display_, rect);
+        }
+        painter.setClipRegion(region);
+
+        if (visionMode_ != VisionMode::Normal && region.intersects(visionLabelRect())) {
+            drawVisionLabel(painter);
+        }
+
+        if (selection_.isValid() && region.intersects(selection_.united(paletteRect(selection_)))) {
+            drawSelection(painter);
+        }
+
+        if (dirtyRect_.isValid() && region.intersects(dirtyRect_)) {
+            QPoint cursor = lastCursor_;
+            drawMagnifier(painter, cursor);
+
+            // Draw crosshair
+            painter.setPen(QPen(Qt::white, 2));
+            painter.drawLine(cursor.x() - 10, cursor.y(), cursor.x() + 10, cursor.y());
+            painter.drawLine(cursor.x(), cursor.y() - 10, cursor.x(), cursor.y() + 10);
+        }
+
+        if (hudEnabled_ && region.intersects(hudRect())) {
+            drawHud(painter);
+        }
+
+        painter.end();
+
+        frameStats_.record(pendingFrameNs_ + paintTimer.nsecsElapsed(), frameBudgetNs_);
+        pendingFrameNs_ = 0;
+
+        if (shownAtNs_ >= 0) {
+            Tracer::instance().record("show to first paint", shownAtNs_, Tracer::instance().now());
+            shownAtNs_ = -1;
+        }
+    }
+
+    void updateDisplay() {
+        TraceSpan span("updateDisplay");
+        QElapsedTimer updateTimer;
+        updateTimer.start();
+
+        // Invalidate where the magnifier was and where it is now, nothing else
+        QRect newRect = overlayBounds(lastCursor_);
+        QRegion dirty(dirtyRect_);
+        dirty += newRect;
+        dirtyRect_ = newRect;
+        if (hudEnabled_) dirty += hudRect();
+
+        update(dirty);
+
+        pendingFrameNs_ += updateTimer.nsecsElapsed();
+    }
+
+    QRect hudRect() const { return QRect(10, 10, 340, 24); }
+
+    QRect visionLabelRect() const { return QRect(width() / 2 - 110, 10, 220, 24); }
+
+    void drawVisionLabel(QPainter& painter) {
+        const QRect rect = visionLabelRect();
+        painter.fillRect(rect, QColor(0, 0, 0, 200));
+        painter.setPen(Qt::white);
+        painter.drawText(rect, Qt::AlignCenter, QString("%1 (V to cycle)").arg(visionModeName(visionMode_)));
+    }
+
+    // numbers cover the frames before this one, the current frame is still being timed
+    void drawHud(QPainter& painter) {
+        QString text = "frame time: no frames yet";
+        if (frameStats_.frames() > 0) {
+            text = QString("frame p50 %1 ms  p99 %2 ms  dropped %3/%4")
+                       .arg(frameStats_.percentile(0.50) / 1e6, 0, 'f', 2)
+                       .arg(frameStats_.percentile(0.99) / 1e6, 0, 'f', 2)
+                       .arg(frameStats_.dropped())
+                       .arg(frameStats_.frames());
+        }
+        const QRect rect = hudRect();
+        painter.fillRect(rect, QColor(0, 0, 0, 200));
+        painter.setPen(Qt::white);
+        painter.drawText(rect.adjusted(8, 0, -8, 0), Qt::AlignLeft | Qt::AlignVCenter, text);
+    }
+
+    void drawMagnifier(QPainter& painter, const QPoint& cursor) {
+        TraceSpan span("drawMagnifier");
+        QRect magnifier = magnifierRect(cursor);
+        int magnifierSize = magnifier.width();
+        QPoint magnifierPos = magnifier.topLeft();
+        if (magnifierSize < 3) return;
+
+        // at least 3 pixels are shown, so a magnifier shrunk to a small screen
+        // zooms less rather than drawing past its frame
+        const int zoom = qMin(zoomFactor_, magnifierSize / 3);
+
+        // Extract region around cursor from the original screenshot.
+        // Important: use an odd number of pixels so there is a real center pixel.
+        int capturePixels = magnifierSize / zoom;
+        if (capturePixels < 3) capturePixels = 3;
+        if ((capturePixels % 2) == 0) capturePixels -= 1;
+        int radius = capturePixels / 2;
+
+        const QRect wanted(cursor.x() - radius, cursor.y() - radius, capturePixels, capturePixels);
+        const QRect sourceRect = wanted.intersected(displaySampler_.rect());
+        if (sourceRect.isEmpty()) return;
+
+        // the zoomed square is centred in the magnifier, the cursor's pixel in its middle
+        const int margin = (magnifierSize - capturePixels * zoom) / 2;
+        const QPoint origin = magnifierPos + QPoint(margin, margin);
+        auto toMagnifier = [&](const QPoint& p) { return origin + (p - wanted.topLeft()) * zoom; };
+
+        // off-screen part at the screen edges
+        if (sourceRect != wanted) {
+            painter.fillRect(QRect(origin, QSize(capturePixels * zoom, capturePixels * zoom)), Qt::black);
+        }
+
+        // Zoomed tiles from the cache, only the ones scrolling into view are
+        // zoomed this frame; grid included, no smoothing
+        const int tilePixels = MagnifierTileCache::tilePixels(zoom);
+        const bool grid = zoom >= 4;
+        for (int ty = sourceRect.top() / tilePixels; ty <= sourceRect.bottom() / tilePixels; ++ty) {
+            for (int tx = sourceRect.left() / tilePixels; tx <= sourceRect.right() / tilePixels; ++tx) {
+                QRect tileRect;
+                const QImage& tile = tileCache_.tile(zoom, grid, QPoint(tx, ty), &tileRect);
+                const QRect visible = tileRect.intersected(sourceRect);
+                painter.drawImage(toMagnifier(visible.topLeft()), tile,
+                                  QRect((visible.topLeft() - tileRect.topLeft()) * zoom,
+                                        QSize(visible.width() * zoom, visible.height() * zoom)));
+            }
+        }
+
+        // centre-pixel marker: a border inside the cursor's cell
+        const QRect cell(toMagnifier(cursor), QSize(zoom, zoom));
+        const int border = qMin(2, zoom / 2);
+        const QColor markerColor(255, 0, 0);
+        painter.fillRect(QRect(cell.left(), cell.top(), cell.width(), border), markerColor);
+        painter.fillRect(QRect(cell.left(), cell.bottom() - border + 1, cell.width(), border), markerColor);
+        painter.fillRect(QRect(cell.left(), cell.top(), border, cell.height()), markerColor);
+        painter.fillRect(QRect(cell.right() - border + 1, cell.top(), border, cell.height()), markerColor);
+
+        // Get and display color at cursor from original screenshot
+        // Outline the averaged area when it fits in the magnifier
+        if (sampleSize_ > 1 && sampleSize_ < capturePixels) {
+            const int radius = sampleSize_ / 2;
+            QRect box = QRect(cursor.x() - radius, cursor.y() - radius, sampleSize_, sampleSize_)
+                            .intersected(sourceRect);
+            const QPoint boxPos = toMagnifier(box.topLeft());
+            painter.setPen(QPen(Qt::white, 1));
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRect(boxPos.x(), boxPos.y(), box.width() * zoom - 1, box.height() * zoom - 1);
+        }
+
+        if (!sampler_.contains(cursor)) return;
+        QColor color = sampleColor(cursor);
+
+        // Draw color info box - show only the selected format, reformatted only when the color changes
+        readout_.update(color.rgba(), colorFormat_, namedColors_.get());
+        readout_.draw(painter, readoutRect(magnifier));
+    }
+
+    QString clipboardText(QRgb color) const {
+        return formatPickedColor(color, colorFormat_, namedColors_.get(), namedColorMode_);
+    }
+
+    // Drag selection: outline and swatch strip are the only invalidated areas,
+    // so a large selection costs no more per move than a small one.
+    QRegion selectionRegion(const QRect& selection) const {
+        if (!selection.isValid()) return QRegion();
+        QRegion outline = QRegion(selection).subtracted(QRegion(selection.adjusted(2, 2, -2, -2)));
+        return outline + paletteRect(selection);
+    }
+
+    // swatch strip below the selection, above it or inside it, whichever fits
+    QRect paletteRect(const QRect& selection) const {
+        QSize size(paletteSize_ * 24 + 4, 28);
+        QPoint pos(selection.left(), selection.bottom() + 6);
+        if (pos.y() + size.height() > height()) pos.setY(selection.top() - 6 - size.height());
+        if (pos.y() < 0) pos.setY(selection.top() + 6);
+        pos.setX(qBound(0, pos.x(), qMax(0, width() - size.width())));
+        return QRect(pos, size);
+    }
+
+    void drawSelection(QPainter& painter) {
+        const QRect outline = selection_.adjusted(0, 0, -1, -1);
+        painter.setBrush(Qt::NoBrush);
+        painter.setPen(QPen(Qt::black, 1));
+        painter.drawRect(outline);
+        painter.setPen(QPen(Qt::white, 1, Qt::DashLine));
+        painter.drawRect(outline);
+
+        // latest preview, most common color first
+        const QRect strip = paletteRect(selection_);
+        painter.fillRect(strip, QColor(0, 0, 0, 200));
+        for (size_t i = 0; i < palette_.size(); ++i) {
+            painter.fillRect(QRect(strip.left() + 4 + int(i) * 24, strip.top() + 4, 20, 20),
+                             QColor::fromRgb(palette_[i].color));
+        }
+    }
+
+    void updateSelection(const QPoint& pos) {
+        // jitter during a click is not a drag
+        if (!selection_.isValid() && (pos - dragOrigin_).manhattanLength() < QApplication::startDragDistance()) {
+            return;
+        }
+        QRegion dirty = selectionRegion(selection_);
+        selection_ = QRect(dragOrigin_, pos).normalized().intersected(rect());
+        dirty += selectionRegion(selection_);
+        update(dirty);
+        requestPreview();
+    }
+
+    void clearSelection() {
+        update(selectionRegion(selection_));
+        dragging_ = false;
+        selection_ = QRect();
+        palette_.clear();
+        previewPending_ = false;
+    }
+
+    // Live preview on a subsampled grid, one job in flight at a time; moves that
+    // arrive meanwhile are folded into a single follow-up run.
+    void requestPreview() {
+        if (paletteWatcher_.isRunning()) {
+            previewPending_ = true;
+            return;
+        }
+        previewPending_ = false;
+        const PixelSampler sampler = sampler_;
+        const QRect region = selection_;
+        const int count = paletteSize_;
+        paletteWatcher_.setFuture(QtConcurrent::run([sampler, region, count]() {
+            TraceSpan span("palette preview");
+            return extractPalette(sampler, region, count, paletteStep(region));
+        }));
+    }
+
+    void pickColor(const QPoint& localPos) {
+        // Get color from screenshot at click position
+        if (!sampler_.contains(localPos)) return;
+        QColor color = sampleColor(localPos);
+
+        // Copy to clipboard in selected format
+        QString colorText = clipboardText(color.rgb());
+        QClipboard* clipboard = QApplication::clipboard();
+        clipboard->setText(colorText);
+
+        const int radius = sampleSize_ / 2;
+        const QRect box = QRect(localPos.x() - radius, localPos.y() - radius, sampleSize_, sampleSize_)
+                              .intersected(sampler_.rect());
+        emit picked(box.translated(screen_->geometry().topLeft()), colorText);
+        emit colorPicked(colorText);
+    }
+
+    // every pixel of the selection this time, one formatted color per line
+    void pickPalette() {
+        TraceSpan span("pick palette");
+        paletteWatcher_.waitForFinished();
+        QStringList lines;
+        for (const PaletteColor& entry : extractPalette(sampler_, selection_, paletteSize_)) {
+            lines << clipboardText(entry.color);
+        }
+        // colors snapped to the same entry
+        lines.removeDuplicates();
+        if (lines.isEmpty()) return;
+
+        QString paletteText = lines.join('\n');
+        QApplication::clipboard()->setText(paletteText);
+        emit picked(selection_.translated(screen_->geometry().topLeft()), paletteText);
+        emit colorPicked(paletteText);
+    }
+
+    void mouseMoveEvent(QMouseEvent* event) override {
+        if (dragging_ && (event->buttons() & Qt::LeftButton)) updateSelection(event->pos());
+        emit cursorMoved(event->pos());
+    }
+
+    void wheelEvent(QWheelEvent* event) override {
+        // high-resolution wheels send fractions of a 120 unit notch
+        wheelDelta_ += event->angleDelta().y();
+        const int steps = wheelDelta_ / 120;
+        wheelDelta_ -= steps * 120;
+        if (steps != 0) changeZoom(steps);
+    }
+
+    void changeZoom(int steps) {
+        const int zoom = stepZoom(zoomFactor_, steps);
+        if (zoom == zoomFactor_) return;
+        zoomFactor_ = zoom;
+        if (lastCursor_ != QPoint(-1000, -1000)) updateDisplay();
+        emit zoomChanged(zoom);
+    }
+
+    void leaveEvent(QEvent*) override {
+        emit cursorLeft();
+    }
+
+    void mousePressEvent(QMouseEvent* event) override {
+        if (event->button() == Qt::LeftButton) {
+            // a click picks on release, dragging first selects a region for a palette
+            dragging_ = true;
+            dragOrigin_ = event->pos();
+        } else if (event->button() == Qt::RightButton) {
+            // Cancel
+            emit closeAllOverlays();
+        }
+    }
+
+    void mouseReleaseEvent(QMouseEvent* event) override {
+        if (event->button() != Qt::LeftButton || !dragging_) return;
+        if (selection_.isValid()) {
+            pickPalette();
+        } else {
+            pickColor(dragOrigin_);
+        }
+        emit closeAllOverlays();
+    }
+
+    void keyPressEvent(QKeyEvent* event) override {
+        if (event->key() == Qt::Key_Escape) {
+            // Escape drops a selection first, then closes
+            if (dragging_) {
+                clearSelection();
+            } else {
+                emit closeAllOverlays();
+            }
+        } else if (event->key() == Qt::Key_V) {
+            // Shift+V goes backwards
+            emit cycleVisionMode(event->modifiers() & Qt::ShiftModifier ? -1 : 1);
+        } else if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal) {
+            changeZoom(1);
+        } else if (event->key() == Qt::Key_Minus) {
+            changeZoom(-1);
+        }
+    }
+
+   signals:
+    void colorPicked(const QString& colorText);
+    void closeAllOverlays();
+    void cursorMoved(const QPoint& localPos);
+    void cursorLeft();
+    void cycleVisionMode(int step);
+    void zoomChanged(int zoom);
+    // what a pick covered, virtual desktop coordinates, for the session record
+    void picked(const QRect& globalArea, const QString& colorText);
+
+   private:
+    static constexpr int kReadoutGap = 5;  // between the magnifier and the color box
+    static constexpr int kReadoutHeight = 50;
+
+    QImage screenshot_;     // View of this screen in the shared capture (RGB32), painted as-is
+    PixelSampler sampler_;  // Pixel access over the same buffer
+    QImage display_;  // what is painted: screenshot_, or a view of the vision preview
+    PixelSampler displaySampler_;  // for the magnifier, over display_
+    VisionMode visionMode_ = VisionMode::Normal;
+    MagnifierTileCache tileCache_;  // zoomed tiles of display_, dropped when display_ changes
+    std::shared_ptr<const IntegralImage> integral_;
+    int sampleSize_ = 1;  // side of the averaged box, 1 = single pixel
+    QScreen* screen_;
+    ColorFormat colorFormat_;
+    ColorReadout readout_;
+    std::shared_ptr<const NamedColorIndex> namedColors_;
+    NamedColorMode namedColorMode_ = NamedColorMode::Show;
+    int zoomFactor_;
+    int magnifierSize_ = 150;
+    int wheelDelta_ = 0;  // wheel rotation short of a notch
+    QPoint lastCursor_;
+    QRect dirtyRect_;  // area covered by the magnifier and crosshair last frame
+    FrameStats frameStats_;
+    qint64 pendingFrameNs_ = 0;
+    qint64 frameBudgetNs_ = 0;
+    qint64 shownAtNs_ = -1;  // tracer time of beginPick(), -1 once painted or when not tracing
+    bool hudEnabled_ = false;
+    int paletteSize_ = 5;
+    bool dragging_ = false;  // left button went down on this overlay
+    QPoint dragOrigin_;
+    QRect selection_;  // drag selection, invalid until the drag passes the start distance
+    std::vector<PaletteColor> palette_;  // live preview of the selection
+    QFutureWatcher<std::vector<PaletteColor>> paletteWatcher_;
+    bool previewPending_ = false;  // the selection changed while a preview was running
+};
+
+// Coalesces cursor moves from every overlay into at most one render per
+// display refresh, on the overlay under the cursor only. Nothing is armed
+// while the cursor is still, so the picker stays idle between moves.
+class FrameScheduler : public QObject {
+    Q_OBJECT
+
+   public:
+    explicit FrameScheduler(QObject* parent = nullptr) : QObject(parent) {
+        timer_.setSingleShot(true);
+        timer_.setTimerType(Qt::PreciseTimer);
+        connect(&timer_, &QTimer::timeout, this, &FrameScheduler::renderFrame);
+        lastFrame_.start();
+    }
+
+    void requestFrame(ColorPickerOverlay* overlay, const QPoint& localPos) {
+        if (target_ && target_ != overlay) {
+            // cursor crossed to another screen
+            target_->clearCursor();
+        }
+        target_ = overlay;
+        pendingPos_ = localPos;
+        pending_ = true;
+
+        if (timer_.isActive()) return;
+
+        qint64 period = refreshPeriodNs(overlay->overlayScreen());
+        qint64 remaining = period - lastFrame_.nsecsElapsed();
+        if (remaining <= 0) {
+            renderFrame();
+        } else {
+            timer_.start(int((remaining + 999999) / 1000000));
+        }
+    }
+
+    void cancel(ColorPickerOverlay* overlay) {
+        if (target_ != overlay) return;
+        overlay->clearCursor();
+        target_ = nullptr;
+        pending_ = false;
+        timer_.stop();
+    }
+
+    void reset() {
+        target_ = nullptr;
+        pending_ = false;
+        timer_.stop();
+    }
+
+   private slots:
+    void renderFrame() {
+        if (!pending_ || !target_) return;
+        pending_ = false;
+        lastFrame_.restart();
+        target_->setCursorPosition(pendingPos_);
+    }
+
+   private:
+    QTimer timer_;
+    QElapsedTimer lastFrame_;
+    QPointer<ColorPickerOverlay> target_;
+    QPoint pendingPos_;
+    bool pending_ = false;
+};
@@ -0,0 +1,242 @@
+#include "palette.h"
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "trace.h"
+
+namespace {
+
+// 5 bits per channel
+constexpr int kBins = 1 << 15;
+// fewer samples than this are not worth a task of their own
+constexpr qint64 kMinBandSamples = 1 << 16;
+constexpr int kRefinePasses = 3;
+
+struct Bin {
+    quint64 count;
+    quint64 sum[3];
+};
+
+// sampled rows [first, last) of the region and their private histogram
+struct Band {
+    int first;
+    int last;
+    std::vector<Bin> bins;
+};
+
+// occupied bin: quantised position for median cut, mean color for k-means
+struct Entry {
+    int q[3];
+    float mean[3];
+    quint64 count;
+};
+
+struct Box {
+    int begin;
+    int end;
+    quint64 pixels;
+    int axis;
+    int range;
+};
+
+inline int binIndex(QRgb p) {
+    return int(((p >> 9) & 0x7c00) | ((p >> 6) & 0x03e0) | ((p >> 3) & 0x001f));
+}
+
+void accumulate(const PixelSampler& sampler, const QRect& region, int step, Band& band) {
+    band.bins.assign(kBins, Bin{});
+    Bin* bins = band.bins.data();
+    for (int row = band.first; row < band.last; ++row) {
+        const QRgb* line = sampler.scanLine(region.top() + row * step);
+        for (int x = region.left(); x <= region.right(); x += step) {
+            const QRgb p = line[x];
+            Bin& bin = bins[binIndex(p)];
+            ++bin.count;
+            bin.sum[0] += qRed(p);
+            bin.sum[1] += qGreen(p);
+            bin.sum[2] += qBlue(p);
+        }
+    }
+}
+
+void measure(const std::vector<Entry>& entries, Box& box) {
+    int lo[3] = {31, 31, 31};
+    int hi[3] = {0, 0, 0};
+    box.pixels = 0;
+    for (int i = box.begin; i < box.end; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = qMin(lo[c], entries[i].q[c]);
+            hi[c] = qMax(hi[c], entries[i].q[c]);
+        }
+        box.pixels += entries[i].count;
+    }
+    box.axis = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (hi[c] - lo[c] > hi[box.axis] - lo[box.axis]) box.axis = c;
+    }
+    box.range = hi[box.axis] - lo[box.axis];
+}
+
+// splits the most populous box that still has extent, at its weighted median
+std::vector<Box> medianCut(std::vector<Entry>& entries, int count) {
+    std::vector<Box> boxes(1, Box{0, int(entries.size()), 0, 0, 0});
+    measure(entries, boxes[0]);
+
+    while (int(boxes.size()) < count) {
+        int pick = -1;
+        double best = 0;
+        for (int i = 0; i < int(boxes.size()); ++i) {
+            double score = double(boxes[i].pixels) * boxes[i].range;
+            if (score > best) {
+                best = score;
+                pick = i;
+            }
+        }
+        if (pick < 0) break;
+
+        Box& box = boxes[pick];
+        const int axis = box.axis;
+        std::sort(entries.begin() + box.begin, entries.begin() + box.end,
+                  [axis](const Entry& a, const Entry& b) { return a.q[axis] < b.q[axis]; });
+
+        int split = box.begin + 1;
+        quint64 seen = 0;
+        for (int i = box.begin; i < box.end - 1; ++i) {
+            seen += entries[i].count;
+            split = i + 1;
+            if (seen * 2 >= box.pixels) break;
+        }
+
+        Box upper{split, box.end, 0, 0, 0};
+        box.end = split;
+        measure(entries, box);
+        measure(entries, upper);
+        boxes.push_back(upper);
+    }
+    return boxes;
+}
+
+int nearest(const float* color, const std::vector<std::array<float, 3>>& centroids) {
+    int best = 0;
+    float bestDistance = std::numeric_limits<float>::max();
+    for (int k = 0; k < int(centroids.size()); ++k) {
+        const float dr = color[0] - centroids[k][0];
+        const float dg = color[1] - centroids[k][1];
+        const float db = color[2] - centroids[k][2];
+        const float distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = k;
+        }
+    }
+    return best;
+}
+
+}  // namespace
+
+std::vector<PaletteColor> extractPalette(const PixelSampler& sampler, const QRect& region, int count, int step) {
+    const QRect area = region.intersected(sampler.rect());
+    if (area.isEmpty() || count < 1) return {};
+    step = qMax(1, step);
+
+    // one band per core, but never so thin that the task costs more than it saves
+    const int rows = (area.height() + step - 1) / step;
+    const qint64 columns = (area.width() + step - 1) / step;
+    const qint64 samples = rows * columns;
+    const int bandCount = int(qBound<qint64>(1, samples / kMinBandSamples,
+                                              qMin(QThreadPool::globalInstance()->maxThreadCount(), rows)));
+
+    std::vector<Band> bands(bandCount);
+    for (int i = 0; i < bandCount; ++i) {
+        bands[i].first = int(qint64(rows) * i / bandCount);
+        bands[i].last = int(qint64(rows) * (i + 1) / bandCount);
+    }
+
+    {
+        TraceSpan span("palette histogram");
+        span.setDetail(QString("%1 samples, %2 bands").arg(samples).arg(bandCount));
+        if (bandCount == 1) {
+            accumulate(sampler, area, step, bands[0]);
+        } else {
+            QtConcurrent::blockingMap(bands, [&](Band& band) { accumulate(sampler, area, step, band); });
+        }
+    }
+
+    std::vector<Entry> entries;
+    {
+        TraceSpan span("palette merge");
+        Bin* total = bands[0].bins.data();
+        for (int i = 1; i < bandCount; ++i) {
+            const Bin* bins = bands[i].bins.data();
+            for (int b = 0; b < kBins; ++b) {
+                total[b].count += bins[b].count;
+                for (int c = 0; c < 3; ++c) total[b].sum[c] += bins[b].sum[c];
+            }
+        }
+        for (int b = 0; b < kBins; ++b) {
+            if (total[b].count == 0) continue;
+            Entry entry;
+            entry.q[0] = (b >> 10) & 31;
+            entry.q[1] = (b >> 5) & 31;
+            entry.q[2] = b & 31;
+            for (int c = 0; c < 3; ++c) entry.mean[c] = float(double(total[b].sum[c]) / total[b].count);
+            entry.count = total[b].count;
+            entries.push_back(entry);
+        }
+    }
+
+    TraceSpan span("palette clustering");
+    span.setDetail(QString("%1 bins").arg(entries.size()));
+
+    // median cut seeds, each the weighted mean of its box
+    std::vector<std::array<float, 3>> centroids;
+    for (const Box& box : medianCut(entries, count)) {
+        double sum[3] = {0, 0, 0};
+        for (int i = box.begin; i < box.end; ++i) {
+            for (int c = 0; c < 3; ++c) sum[c] += double(entries[i].mean[c]) * entries[i].count;
+        }
+        centroids.push_back({float(sum[0] / box.pixels), float(sum[1] / box.pixels), float(sum[2] / box.pixels)});
+    }
+
+    // weighted k-means over the bins; an emptied cluster keeps its last position
+    std::vector<std::array<double, 3>> sums(centroids.size());
+    std::vector<quint64> pixels(centroids.size());
+    for (int pass = 0; pass <= kRefinePasses; ++pass) {
+        std::fill(sums.begin(), sums.end(), std::array<double, 3>{0, 0, 0});
+        std::fill(pixels.begin(), pixels.end(), 0);
+        for (const Entry& entry : entries) {
+            const int k = nearest(entry.mean, centroids);
+            for (int c = 0; c < 3; ++c) sums[k][c] += double(entry.mean[c]) * entry.count;
+            pixels[k] += entry.count;
+        }
+        // the last pass only counts the final assignment
+        if (pass == kRefinePasses) break;
+        for (size_t k = 0; k < centroids.size(); ++k) {
+            if (pixels[k] == 0) continue;
+            for (int c = 0; c < 3; ++c) centroids[k][c] = float(sums[k][c] / pixels[k]);
+        }
+    }
+
+    std::vector<PaletteColor> palette;
+    for (size_t k = 0; k < centroids.size(); ++k) {
+        if (pixels[k] == 0) continue;
+        palette.push_back({qRgb(qBound(0, int(std::lround(centroids[k][0])), 255),
+                                qBound(0, int(std::lround(centroids[k][1])), 255),
+                                qBound(0, int(std::lround(centroids[k][2])), 255)),
+                           qint64(pixels[k])});
+    }
+    std::stable_sort(palette.begin(), palette.end(),
+                     [](const PaletteColor& a, const PaletteColor& b) { return a.pixels > b.pixels; });
+    return palette;
+}
+
+int paletteStep(const QRect& region, qint64 maxSamples) {
+    const double samples = double(region.width()) * region.height();
+    if (samples <= maxSamples) return 1;
+    return int(std::ceil(std::sqrt(samples / maxSamples)));
+}
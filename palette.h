@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QRect>
+#include <QRgb>
+#include <vector>
+
+#include "sampling.h"
+
+struct PaletteColor {
+    QRgb color;
+    qint64 pixels;  // samples that ended up in this color's cluster
+};
+
+// N dominant colors of a region, most common first. The region is split into
+// row bands that build 15-bit histograms in parallel; median cut over the
+// occupied bins gives the seeds, and a few k-means passes over the bins (not
+// the pixels) refine them. step > 1 reads every step-th pixel in both
+// directions, which is what the live preview uses while dragging.
+std::vector<PaletteColor> extractPalette(const PixelSampler& sampler, const QRect& region, int count, int step = 1);
+
+// sampling step that keeps region at roughly maxSamples pixels
+int paletteStep(const QRect& region, qint64 maxSamples = 1 << 18);
@@ -0,0 +1,360 @@
+#include "pickserver.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <climits>
+#include <cmath>
+
+#include "capture.h"
+#include "pixelwatch.h"
+#include "sampling.h"
+#include "trace.h"
+
+namespace {
+
+// JSON numbers are doubles and toInt() quietly turns 10.5 or 1e10 into 0,
+// so coordinates are only taken when they are whole numbers in int range
+bool jsonInt(const QJsonValue& value, int* out) {
+    if (!value.isDouble()) return false;
+    const double number = value.toDouble();
+    if (number != std::floor(number) || number < INT_MIN || number > INT_MAX) return false;
+    *out = int(number);
+    return true;
+}
+
+}  // namespace
+
+PickServer::PickServer(PickService* service, QObject* parent) : QObject(parent), service_(service) {
+    server_.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&server_, &QLocalServer::newConnection, this, &PickServer::onNewConnection);
+
+    sampleTimer_.setSingleShot(true);
+    connect(&sampleTimer_, &QTimer::timeout, this, &PickServer::flushSamples);
+}
+
+QString PickServer::defaultSocketPath() {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (dir.isEmpty()) dir = QDir::tempPath();
+    return dir + "/colorpicker.sock";
+}
+
+bool PickServer::listen(const QString& path) {
+    if (server_.listen(path)) return true;
+
+    // a socket file nobody answers on is left over from a crash
+    if (server_.serverError() == QAbstractSocket::AddressInUseError) {
+        QLocalSocket probe;
+        probe.connectToServer(path);
+        if (probe.waitForConnected(200)) return false;
+        QLocalServer::removeServer(path);
+        return server_.listen(path);
+    }
+    return false;
+}
+
+void PickServer::finishPick(const QString& colorText, bool picked) {
+    const auto waiting = pendingPicks_;
+    pendingPicks_.clear();
+    for (const auto& [socket, id] : waiting) {
+        if (!socket) continue;
+        if (picked) {
+            QJsonObject response;
+            response["text"] = colorText;
+            reply(socket, id, response);
+        } else {
+            replyError(socket, id, "cancelled");
+        }
+    }
+}
+
+void PickServer::onNewConnection() {
+    while (QLocalSocket* socket = server_.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readRequests(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() { dropWatches(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void PickServer::readRequests(QLocalSocket* socket) {
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) continue;
+
+        QJsonParseError error;
+        const QJsonDocument document = QJsonDocument::fromJson(line, &error);
+        if (!document.isObject()) {
+            replyError(socket, QJsonValue(), QString("bad request: %1").arg(error.errorString()));
+            continue;
+        }
+        handleRequest(socket, document.object());
+    }
+
+    if (socket->bytesAvailable() > kMaxLineBytes) {
+        replyError(socket, QJsonValue(), "request too long");
+        socket->disconnectFromServer();
+    }
+}
+
+void PickServer::handleRequest(QLocalSocket* socket, const QJsonObject& request) {
+    const QJsonValue id = request.value("id");
+    const QString command = request.value("cmd").toString();
+
+    if (command == "sample") {
+        queueSamples(socket, request);
+    } else if (command == "pick") {
+        pendingPicks_.append({socket, id});
+        service_->startInteractivePick();
+    } else if (command == "history") {
+        QJsonObject response;
+        response["history"] = service_->pickHistory(request.value("limit").toInt(100));
+        reply(socket, id, response);
+    } else if (command == "watch") {
+        addWatches(socket, request);
+    } else if (command == "unwatch") {
+        removeWatches(socket, request);
+    } else {
+        replyError(socket, id, QString("unknown cmd: %1").arg(command));
+    }
+}
+
+void PickServer::queueSamples(QLocalSocket* socket, const QJsonObject& request) {
+    const QJsonValue id = request.value("id");
+
+    SampleRequest sample{socket, id, {}, ColorFormat::HEX, request.value("average").toInt(1)};
+    if (request.contains("format") && !parseColorFormat(request.value("format").toString(), &sample.format)) {
+        replyError(socket, id, QString("unknown format: %1").arg(request.value("format").toString()));
+        return;
+    }
+    if (sample.average < 1 || sample.average > 101) {
+        replyError(socket, id, "average must be between 1 and 101");
+        return;
+    }
+
+    const QJsonArray points = request.value("points").toArray();
+    sample.points.reserve(points.size());
+    for (const QJsonValue& point : points) {
+        const QJsonArray xy = point.toArray();
+        int x = 0;
+        int y = 0;
+        if (xy.size() != 2 || !jsonInt(xy[0], &x) || !jsonInt(xy[1], &y)) {
+            replyError(socket, id, "points must be [x, y] pairs of integers");
+            return;
+        }
+        sample.points.emplace_back(x, y);
+    }
+
+    pendingSamples_.push_back(std::move(sample));
+    // after this event loop turn, so requests read meanwhile join the batch
+    if (!sampleTimer_.isActive()) scheduleSamples(0);
+}
+
+void PickServer::scheduleSamples(int delayMs) {
+    sampleTimer_.start(delayMs);
+}
+
+// Every request queued since the last flush is answered from one capture of
+// the rectangle covering all points and their averaging boxes.
+void PickServer::flushSamples() {
+    if (pendingSamples_.empty() || sampleCaptureInFlight_) return;
+    if (service_->captureBusy()) {
+        // an interactive pick is capturing, its backend is not free yet
+        scheduleSamples(5);
+        return;
+    }
+
+    std::vector<SampleRequest> batch;
+    batch.swap(pendingSamples_);
+
+    QRect bounds;
+    for (const SampleRequest& request : batch) {
+        const int radius = request.average / 2;
+        for (const QPoint& point : request.points) {
+            bounds |= QRect(point.x() - radius, point.y() - radius, request.average, request.average);
+        }
+    }
+    bounds &= virtualDesktopGeometry();
+    if (bounds.isEmpty()) {
+        answerSamples(batch, bounds, QImage(), 0);
+        return;
+    }
+
+    // the replies go out when the capture lands, the GUI thread keeps serving meanwhile
+    sampleCaptureInFlight_ = true;
+    QElapsedTimer timer;
+    timer.start();
+    service_->captureRect(bounds, [this, batch = std::move(batch), bounds, timer](const QImage& capture) {
+        sampleCaptureInFlight_ = false;
+        answerSamples(batch, bounds, capture, timer.nsecsElapsed() / 1e6);
+        if (!pendingSamples_.empty()) scheduleSamples(0);
+    });
+}
+
+void PickServer::answerSamples(const std::vector<SampleRequest>& batch, const QRect& bounds, const QImage& capture,
+                               double captureMs) {
+    TraceSpan span("socket sample batch");
+    span.setDetail(QString("%1 requests, %2x%3").arg(batch.size()).arg(bounds.width()).arg(bounds.height()));
+
+    const bool captured = !capture.isNull();
+    const ColorFormatter& formatter = ColorFormatter::instance();
+    const PixelSampler sampler(capture);
+    for (const SampleRequest& request : batch) {
+        if (!request.socket) continue;
+        // nothing to capture is only an error when points were asked for
+        if (!captured && !bounds.isEmpty()) {
+            replyError(request.socket, request.id, "capture failed");
+            continue;
+        }
+
+        QJsonArray colors;
+        const int radius = request.average / 2;
+        for (const QPoint& point : request.points) {
+            const QPoint local = point - bounds.topLeft();
+            if (!captured || !sampler.contains(local)) {
+                // off every screen
+                colors.append(QJsonValue());
+                continue;
+            }
+            QRgb pixel = sampler.pixel(local);
+            if (request.average > 1) {
+                QRect box = QRect(local.x() - radius, local.y() - radius, request.average, request.average);
+                pixel = averageBox(sampler, box.intersected(sampler.rect()));
+            }
+            char buffer[ColorFormatter::kMaxLength];
+            colors.append(QString::fromLatin1(buffer, formatter.format(pixel, request.format, buffer)));
+        }
+
+        QJsonObject response;
+        response["colors"] = colors;
+        response["capture_ms"] = captureMs;
+        response["batch"] = int(batch.size());
+        reply(request.socket, request.id, response);
+    }
+}
+
+void PickServer::addWatches(QLocalSocket* socket, const QJsonObject& request) {
+    const QJsonValue id = request.value("id");
+
+    ColorFormat format = ColorFormat::HEX;
+    if (request.contains("format") && !parseColorFormat(request.value("format").toString(), &format)) {
+        replyError(socket, id, QString("unknown format: %1").arg(request.value("format").toString()));
+        return;
+    }
+    const double threshold = request.value("threshold").toDouble(0.02);
+    if (threshold < 0) {
+        replyError(socket, id, "threshold must not be negative");
+        return;
+    }
+
+    // all or nothing, so a bad entry leaves no half-registered set behind
+    std::vector<QRect> areas;
+    for (const QJsonValue& point : request.value("points").toArray()) {
+        const QJsonArray xy = point.toArray();
+        int x = 0;
+        int y = 0;
+        if (xy.size() != 2 || !jsonInt(xy[0], &x) || !jsonInt(xy[1], &y)) {
+            replyError(socket, id, "points must be [x, y] pairs of integers");
+            return;
+        }
+        areas.emplace_back(x, y, 1, 1);
+    }
+    for (const QJsonValue& region : request.value("regions").toArray()) {
+        const QJsonArray rect = region.toArray();
+        int values[4] = {};
+        bool ok = rect.size() == 4;
+        for (int i = 0; ok && i < 4; ++i) ok = jsonInt(rect[i], &values[i]);
+        if (!ok || values[2] < 1 || values[3] < 1) {
+            replyError(socket, id, "regions must be [x, y, w, h] integers with a positive size");
+            return;
+        }
+        areas.emplace_back(values[0], values[1], values[2], values[3]);
+    }
+    if (areas.empty()) {
+        replyError(socket, id, "nothing to watch");
+        return;
+    }
+    for (const QRect& area : areas) {
+        if (!watchAreaOnScreen(area)) {
+            replyError(socket, id, QString("area %1,%2 %3x%4 is not on one screen")
+                                       .arg(area.x())
+                                       .arg(area.y())
+                                       .arg(area.width())
+                                       .arg(area.height()));
+            return;
+        }
+    }
+
+    PixelWatcher* watcher = service_->pixelWatcher();
+    if (!watcherConnected_) {
+        watcherConnected_ = true;
+        connect(watcher, &PixelWatcher::colorChanged, this, &PickServer::onWatchChanged);
+    }
+    QJsonArray ids;
+    for (const QRect& area : areas) {
+        const int watch = watcher->addTarget(area, float(threshold));
+        watches_.insert(watch, {socket, format});
+        ids.append(watch);
+    }
+
+    QJsonObject response;
+    response["watches"] = ids;
+    reply(socket, id, response);
+}
+
+// the connection's own watches, all of them without a "watches" list
+void PickServer::removeWatches(QLocalSocket* socket, const QJsonObject& request) {
+    if (!request.contains("watches")) {
+        dropWatches(socket);
+    } else {
+        for (const QJsonValue& value : request.value("watches").toArray()) {
+            const int watch = value.toInt();
+            auto it = watches_.find(watch);
+            if (it == watches_.end() || it->socket != socket) continue;
+            watches_.erase(it);
+            service_->pixelWatcher()->removeTarget(watch);
+        }
+    }
+    reply(socket, request.value("id"), QJsonObject());
+}
+
+void PickServer::dropWatches(QLocalSocket* socket) {
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        if (it->socket && it->socket != socket) {
+            ++it;
+            continue;
+        }
+        service_->pixelWatcher()->removeTarget(it.key());
+        it = watches_.erase(it);
+    }
+}
+
+void PickServer::onWatchChanged(int id, QRgb before, QRgb after, float distance) {
+    auto it = watches_.find(id);
+    if (it == watches_.end() || !it->socket) return;
+
+    const QRect area = service_->pixelWatcher()->area(id);
+    QJsonObject event;
+    event["event"] = "changed";
+    event["watch"] = id;
+    event["area"] = QJsonArray{area.x(), area.y(), area.width(), area.height()};
+    event["before"] = formatColor(QColor::fromRgb(before), it->format);
+    event["after"] = formatColor(QColor::fromRgb(after), it->format);
+    event["distance"] = distance;
+    it->socket->write(QJsonDocument(event).toJson(QJsonDocument::Compact));
+    it->socket->write("\n");
+}
+
+void PickServer::reply(QLocalSocket* socket, const QJsonValue& id, QJsonObject response) {
+    if (!id.isUndefined()) response["id"] = id;
+    if (!response.contains("ok")) response["ok"] = true;
+    socket->write(QJsonDocument(response).toJson(QJsonDocument::Compact));
+    socket->write("\n");
+}
+
+void PickServer::replyError(QLocalSocket* socket, const QJsonValue& id, const QString& error) {
+    QJsonObject response;
+    response["ok"] = false;
+    response["error"] = error;
+    reply(socket, id, response);
+}
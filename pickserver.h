@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QHash>
+#include <QJsonValue>
+#include <QList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QPoint>
+#include <QPointer>
+#include <QRect>
+#include <QTimer>
+#include <functional>
+#include <vector>
+
+#include "colorformat.h"
+
+class PixelWatcher;
+
+// What the socket API needs from the running tray app.
+class PickService {
+   public:
+    virtual ~PickService() = default;
+
+    // starts an interactive pick, or joins the one already running; the app
+    // reports the outcome through PickServer::finishPick()
+    virtual void startInteractivePick() = 0;
+
+    // true while a capture for an interactive pick is running, the backends
+    // are not shared between two captures at once
+    virtual bool captureBusy() const = 0;
+
+    // fresh pixels of rect (virtual desktop coordinates), grabbed off the GUI
+    // thread where the backend allows; done runs on the GUI thread with a null
+    // image if no backend can deliver. The image may be a view that is only
+    // valid during the call.
+    virtual void captureRect(const QRect& rect, std::function<void(const QImage&)> done) = 0;
+
+    // most recent first
+    virtual QJsonArray pickHistory(int limit) const = 0;
+
+    // the app's watcher, created on first use
+    virtual PixelWatcher* pixelWatcher() = 0;
+};
+
+// Local socket API of the resident app, one JSON object per line each way:
+//   {"id": 1, "cmd": "pick"}
+//   {"id": 2, "cmd": "sample", "points": [[x, y], ...], "format": "hex", "average": 1}
+//   {"id": 3, "cmd": "history", "limit": 20}
+//   {"id": 4, "cmd": "watch", "points": [[x, y]], "regions": [[x, y, w, h]], "threshold": 0.02}
+//   {"id": 5, "cmd": "unwatch", "watches": [1, 2]}
+// Replies echo "id" and carry "ok", plus "error" when it is false. Sample
+// requests that arrive together, from any number of clients, are answered
+// from one capture of the rectangle that covers all their points. Watches
+// belong to the connection that made them and push {"event": "changed"}
+// lines to it until it unwatches or disconnects.
+class PickServer : public QObject {
+    Q_OBJECT
+
+   public:
+    explicit PickServer(PickService* service, QObject* parent = nullptr);
+
+    // user-only socket at path, a stale one left by a crash is replaced
+    bool listen(const QString& path);
+    QString errorString() const { return server_.errorString(); }
+
+    // $XDG_RUNTIME_DIR/colorpicker.sock
+    static QString defaultSocketPath();
+
+    // outcome of the interactive pick, answers every client waiting for it
+    void finishPick(const QString& colorText, bool picked);
+
+   private:
+    struct SampleRequest {
+        QPointer<QLocalSocket> socket;
+        QJsonValue id;
+        std::vector<QPoint> points;
+        ColorFormat format;
+        int average;
+    };
+
+    struct Watch {
+        QPointer<QLocalSocket> socket;
+        ColorFormat format;
+    };
+
+    // one line is plenty for a million points
+    static constexpr qint64 kMaxLineBytes = 64 << 20;
+
+    void onNewConnection();
+    void readRequests(QLocalSocket* socket);
+    void handleRequest(QLocalSocket* socket, const QJsonObject& request);
+    void queueSamples(QLocalSocket* socket, const QJsonObject& request);
+    void scheduleSamples(int delayMs);
+    void flushSamples();
+    void answerSamples(const std::vector<SampleRequest>& batch, const QRect& bounds, const QImage& capture,
+                       double captureMs);
+    void addWatches(QLocalSocket* socket, const QJsonObject& request);
+    void removeWatches(QLocalSocket* socket, const QJsonObject& request);
+    void dropWatches(QLocalSocket* socket);
+    void onWatchChanged(int id, QRgb before, QRgb after, float distance);
+    static void reply(QLocalSocket* socket, const QJsonValue& id, QJsonObject response);
+    static void replyError(QLocalSocket* socket, const QJsonValue& id, const QString& error);
+
+    PickService* service_;
+    QLocalServer server_;
+    std::vector<SampleRequest> pendingSamples_;
+    QTimer sampleTimer_;
+    bool sampleCaptureInFlight_ = false;  // requests queued meanwhile wait for the next batch
+    QList<QPair<QPointer<QLocalSocket>, QJsonValue>> pendingPicks_;
+    QHash<int, Watch> watches_;  // by PixelWatcher id
+    bool watcherConnected_ = false;
+};
@@ -0,0 +1,251 @@
+#include "pixelwatch.h"
+
+#include <QDebug>
+#include <QGuiApplication>
+#include <QScreen>
+#include <algorithm>
+#include <cmath>
+
+#include "colorformat.h"
+#include "sampling.h"
+#include "trace.h"
+
+namespace {
+
+// A grab is one round trip to the server plus a copy per pixel; merging two
+// grabs pays off while the extra pixels cost less than the round trip saved.
+constexpr qint64 kMergeSlackPixels = 64 * 64;
+
+qint64 pixels(const QRect& rect) {
+    return qint64(rect.width()) * rect.height();
+}
+
+}  // namespace
+
+std::vector<QRect> mergeWatchRects(const std::vector<QRect>& areas) {
+    // each rectangle with the pixels its areas need on their own
+    std::vector<std::pair<QRect, qint64>> rects;
+    for (const QRect& area : areas) {
+        if (!area.isEmpty()) rects.push_back({area, pixels(area)});
+    }
+
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < rects.size(); ++i) {
+            for (size_t j = i + 1; j < rects.size(); ++j) {
+                const QRect united = rects[i].first | rects[j].first;
+                const qint64 needed = rects[i].second + rects[j].second;
+                if (pixels(united) > needed + kMergeSlackPixels) continue;
+                rects[i] = {united, needed};
+                rects.erase(rects.begin() + j);
+                // the grown rectangle may now reach ones already passed over
+                j = i;
+                merged = true;
+            }
+        }
+    }
+
+    std::vector<QRect> result;
+    result.reserve(rects.size());
+    for (const auto& rect : rects) result.push_back(rect.first);
+    return result;
+}
+
+bool watchAreaOnScreen(const QRect& area) {
+    QScreen* screen = QGuiApplication::screenAt(area.center());
+    return screen && screen->geometry().contains(area);
+}
+
+PixelWatcher::PixelWatcher(QObject* parent) : QObject(parent) {
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &PixelWatcher::poll);
+    sinceGrab_.start();
+}
+
+void PixelWatcher::setCaptureOrder(const QList<CaptureBackend*>& order) {
+    order_ = order;
+    backend_ = nullptr;
+    warnedNoBackend_ = false;
+}
+
+int PixelWatcher::addTarget(const QRect& area, float threshold) {
+    const int id = nextId_++;
+    Target target;
+    target.area = area;
+    target.threshold = threshold;
+    targets_[id] = target;
+    rebuildGroups();
+
+    // connected only once there is something to watch
+    if (!damageTried_) {
+        damageTried_ = true;
+        damage_ = createScreenDamage();
+        if (damage_) {
+            damageNotifier_ = std::make_unique<QSocketNotifier>(damage_->socketDescriptor(), QSocketNotifier::Read);
+            connect(damageNotifier_.get(), &QSocketNotifier::activated, this, &PixelWatcher::onDamage);
+        }
+        qInfo().noquote() << QString("pixel watch: %1").arg(damage_ ? "X Damage events" : "polling");
+    }
+
+    // the first grab records the starting color
+    schedule(0);
+    return id;
+}
+
+void PixelWatcher::removeTarget(int id) {
+    if (targets_.erase(id) == 0) return;
+    rebuildGroups();
+    if (!targets_.empty()) return;
+
+    // nothing left to watch, stop waking up for every redraw
+    timer_.stop();
+    damageNotifier_.reset();
+    damage_.reset();
+    damageTried_ = false;
+}
+
+QRect PixelWatcher::area(int id) const {
+    auto it = targets_.find(id);
+    return it == targets_.end() ? QRect() : it->second.area;
+}
+
+// merged per screen, a grab through grabWindow cannot span two
+void PixelWatcher::rebuildGroups() {
+    std::map<QScreen*, std::vector<QRect>> areas;
+    for (const auto& [id, target] : targets_) {
+        areas[QGuiApplication::screenAt(target.area.center())].push_back(target.area);
+    }
+    groupRects_.clear();
+    for (const auto& [screen, screenAreas] : areas) {
+        const std::vector<QRect> merged = mergeWatchRects(screenAreas);
+        groupRects_.insert(groupRects_.end(), merged.begin(), merged.end());
+    }
+
+    groups_.clear();
+    for (const QRect& rect : groupRects_) groups_.push_back({rect, {}});
+    for (const auto& [id, target] : targets_) {
+        for (Group& group : groups_) {
+            if (group.rect.contains(target.area)) {
+                group.targets.push_back(id);
+                break;
+            }
+        }
+    }
+}
+
+void PixelWatcher::dropDamage() {
+    qWarning() << "pixel watch: lost the X Damage connection, polling instead";
+    damageNotifier_.reset();
+    damage_.reset();
+}
+
+void PixelWatcher::onDamage() {
+    if (!damage_->isConnected()) {
+        dropDamage();
+        schedule(0);
+        return;
+    }
+    if (!damage_->takeDamage(groupRects_)) return;
+    // at most one grab per interval however often the area is redrawn
+    schedule(qMax(0, intervalMs_ - int(sinceGrab_.elapsed())));
+}
+
+// keeps an earlier deadline that is already set
+void PixelWatcher::schedule(int delayMs) {
+    if (targets_.empty()) return;
+    if (timer_.isActive() && timer_.remainingTime() <= delayMs) return;
+    timer_.start(delayMs);
+}
+
+void PixelWatcher::poll() {
+    if (groups_.empty()) return;
+    if (busy_ && busy_()) {
+        schedule(kRetryMs);
+        return;
+    }
+
+    struct Change {
+        int id;
+        QRgb before;
+        QRgb after;
+        float distance;
+    };
+    std::vector<Change> changes;
+    const ColorFormatter& formatter = ColorFormatter::instance();
+    // a group that cannot be grabbed (its screen went away) must not hold up the rest
+    bool grabbed = false;
+    {
+        TraceSpan span("watch grab");
+        span.setDetail(QString("%1 rects, %2 areas").arg(groups_.size()).arg(targets_.size()));
+        sinceGrab_.restart();
+        for (Group& group : groups_) {
+            if (!grab(group.rect)) {
+                if (!group.failed) {
+                    group.failed = true;
+                    qWarning().noquote() << QString("pixel watch: cannot grab %1,%2 %3x%4, skipping it")
+                                                .arg(group.rect.x())
+                                                .arg(group.rect.y())
+                                                .arg(group.rect.width())
+                                                .arg(group.rect.height());
+                }
+                continue;
+            }
+            group.failed = false;
+            grabbed = true;
+            const PixelSampler sampler(buffer_);
+            for (int id : group.targets) {
+                Target& target = targets_[id];
+                const QRgb color = averageBox(sampler, target.area.translated(-group.rect.topLeft()));
+                if (target.known && color == target.color) continue;
+
+                float lab[3];
+                formatter.toOklab(qRed(color), qGreen(color), qBlue(color), lab);
+                if (!target.known) {
+                    target.known = true;
+                } else {
+                    const float distance = std::sqrt((lab[0] - target.lab[0]) * (lab[0] - target.lab[0]) +
+                                                     (lab[1] - target.lab[1]) * (lab[1] - target.lab[1]) +
+                                                     (lab[2] - target.lab[2]) * (lab[2] - target.lab[2]));
+                    // small drifts accumulate against the last reported color
+                    if (distance <= target.threshold) continue;
+                    changes.push_back({id, target.color, color, distance});
+                }
+                target.color = color;
+                std::copy(lab, lab + 3, target.lab);
+            }
+        }
+    }
+
+    // nothing at all came back, the backend itself is failing
+    if (!grabbed) {
+        schedule(kRetryMs);
+    } else if (damage_) {
+        schedule(kDamageSafetyMs);
+    } else {
+        schedule(intervalMs_);
+    }
+
+    // receivers may remove watches
+    for (const Change& change : changes) {
+        if (targets_.count(change.id)) emit colorChanged(change.id, change.before, change.after, change.distance);
+    }
+}
+
+bool PixelWatcher::grab(const QRect& rect) {
+    if (backend_ && backend_->captureRegion(rect, buffer_)) return true;
+
+    // first grab, or the backend stopped working
+    backend_ = nullptr;
+    for (CaptureBackend* backend : order_) {
+        if (backend->isAvailable() && backend->captureRegion(rect, buffer_)) {
+            backend_ = backend;
+            return true;
+        }
+    }
+    if (!warnedNoBackend_) {
+        warnedNoBackend_ = true;
+        qWarning() << "pixel watch: no capture backend can grab a screen region";
+    }
+    return false;
+}
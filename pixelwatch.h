@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QRect>
+#include <QRgb>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "capture.h"
+
+// Rectangles to grab for a set of watched areas. Areas close to each other
+// share one grab as long as it covers few pixels beyond what the separate
+// grabs would; each area ends up inside exactly one returned rectangle.
+std::vector<QRect> mergeWatchRects(const std::vector<QRect>& areas);
+
+// true when one screen holds all of area; grabs are made per screen, so an
+// area off every screen, or across two, could never be watched
+bool watchAreaOnScreen(const QRect& area);
+
+// Watches screen points or small regions (status lights) and reports when
+// their color, averaged over the region, moves further than a threshold in
+// OKLab. Only the watched areas are grabbed, and with X Damage only after
+// something was redrawn over them, so an unchanging screen costs next to
+// nothing. Without Damage the areas are polled at the interval.
+class PixelWatcher : public QObject {
+    Q_OBJECT
+
+   public:
+    explicit PixelWatcher(QObject* parent = nullptr);
+
+    // the first backend in order that can grab a region is used
+    void setCaptureOrder(const QList<CaptureBackend*>& order);
+
+    // no grabs while this returns true, the backends are busy elsewhere
+    void setBusyCheck(std::function<bool()> busy) { busy_ = std::move(busy); }
+
+    // shortest time between two grabs, and the poll interval without Damage
+    void setInterval(int ms) { intervalMs_ = qMax(10, ms); }
+
+    // area in virtual desktop coordinates (1x1 for a point); threshold is an
+    // OKLab distance, about 0.02 is just noticeable. Returns the watch id.
+    int addTarget(const QRect& area, float threshold);
+    void removeTarget(int id);
+    bool isEmpty() const { return targets_.empty(); }
+    QRect area(int id) const;
+
+    // change detection is driven by X Damage events rather than a poll
+    bool usesDamage() const { return damage_ != nullptr; }
+
+   signals:
+    void colorChanged(int id, QRgb before, QRgb after, float distance);
+
+   private:
+    struct Target {
+        QRect area;
+        float threshold;
+        QRgb color = 0;
+        float lab[3] = {};
+        bool known = false;  // false until the first grab
+    };
+
+    // areas that share one grab
+    struct Group {
+        QRect rect;
+        std::vector<int> targets;
+        bool failed = false;  // reported once, then skipped quietly until it grabs again
+    };
+
+    static constexpr int kRetryMs = 250;
+    // damage can miss direct-rendered GL content on some drivers
+    static constexpr int kDamageSafetyMs = 2000;
+
+    void rebuildGroups();
+    void dropDamage();
+    void onDamage();
+    void schedule(int delayMs);
+    void poll();
+    bool grab(const QRect& rect);
+
+    std::map<int, Target> targets_;
+    int nextId_ = 1;
+    std::vector<Group> groups_;
+    std::vector<QRect> groupRects_;
+    QList<CaptureBackend*> order_;
+    CaptureBackend* backend_ = nullptr;  // picked on the first grab
+    std::function<bool()> busy_;
+    std::unique_ptr<ScreenDamage> damage_;
+    std::unique_ptr<QSocketNotifier> damageNotifier_;
+    bool damageTried_ = false;
+    QTimer timer_;
+    QElapsedTimer sinceGrab_;
+    QImage buffer_;  // reused by every grab
+    int intervalMs_ = 100;
+    bool warnedNoBackend_ = false;
+};
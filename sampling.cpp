@@ -0,0 +1,15 @@
+#include "sampling.h"
+
+QRgb averageBox(const PixelSampler& sampler, const QRect& box) {
+    quint64 r = 0, g = 0, b = 0;
+    for (int y = box.top(); y <= box.bottom(); ++y) {
+        const QRgb* row = sampler.scanLine(y);
+        for (int x = box.left(); x <= box.right(); ++x) {
+            r += qRed(row[x]);
+            g += qGreen(row[x]);
+            b += qBlue(row[x]);
+        }
+    }
+    const quint64 count = quint64(box.width()) * box.height();
+    return qRgb(int((r + count / 2) / count), int((g + count / 2) / count), int((b + count / 2) / count));
+}
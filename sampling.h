@@ -0,0 +1,130 @@
+#pragma once
+
+#include <QColor>
+#include <QImage>
+#include <QRect>
+#include <QtConcurrent/QtConcurrentMap>
+#include <vector>
+
+// Read-only pixel access over one RGB32 capture. The sampler is a view: it
+// does not own the pixels, whoever owns the QImage must keep it alive.
+class PixelSampler {
+   public:
+    PixelSampler() = default;
+
+    explicit PixelSampler(const QImage& image)
+        : bits_(image.constBits()),
+          stride_(image.bytesPerLine()),
+          width_(image.width()),
+          height_(image.height()) {
+        Q_ASSERT(image.isNull() || image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32);
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    QRect rect() const { return QRect(0, 0, width_, height_); }
+
+    bool contains(const QPoint& pos) const {
+        return pos.x() >= 0 && pos.y() >= 0 && pos.x() < width_ && pos.y() < height_;
+    }
+
+    qsizetype stride() const { return stride_; }
+
+    const QRgb* scanLine(int y) const {
+        return reinterpret_cast<const QRgb*>(bits_ + y * stride_);
+    }
+
+    // caller guarantees pos is inside rect()
+    QRgb pixel(const QPoint& pos) const {
+        return scanLine(pos.y())[pos.x()];
+    }
+
+    QColor color(const QPoint& pos) const {
+        return QColor::fromRgb(pixel(pos));
+    }
+
+   private:
+    const uchar* bits_ = nullptr;
+    qsizetype stride_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+// Summed-area table over one RGB32 capture: per-channel running sums with a
+// zero first row and column, so the average of any box is four lookups.
+// Sums wrap at 32 bits, which is harmless: differences of wrapped sums are
+// exact as long as one box (at most 101x101x255) fits, which it does.
+class IntegralImage {
+   public:
+    IntegralImage() = default;
+
+    explicit IntegralImage(const QImage& image)
+        : width_(image.width()), height_(image.height()), rowLength_(size_t(image.width() + 1) * 3) {
+        sums_.assign(rowLength_ * (height_ + 1), 0);
+
+        // horizontal prefix sums, one band of rows per task
+        std::vector<int> bands;
+        for (int y = 0; y < height_; y += kBandRows) bands.push_back(y);
+        QtConcurrent::blockingMap(bands, [this, &image](int top) {
+            const int bottom = qMin(top + kBandRows, height_);
+            for (int y = top; y < bottom; ++y) {
+                const QRgb* in = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+                quint32* out = sums_.data() + size_t(y + 1) * rowLength_ + 3;
+                quint32 r = 0, g = 0, b = 0;
+                for (int x = 0; x < width_; ++x) {
+                    r += qRed(in[x]);
+                    g += qGreen(in[x]);
+                    b += qBlue(in[x]);
+                    out[0] = r;
+                    out[1] = g;
+                    out[2] = b;
+                    out += 3;
+                }
+            }
+        });
+
+        // vertical accumulation, one band of columns per task
+        std::vector<size_t> columns;
+        for (size_t x = 0; x < rowLength_; x += kBandColumns) columns.push_back(x);
+        QtConcurrent::blockingMap(columns, [this](size_t left) {
+            const size_t right = qMin(left + kBandColumns, rowLength_);
+            for (int y = 1; y <= height_; ++y) {
+                const quint32* above = sums_.data() + size_t(y - 1) * rowLength_;
+                quint32* row = sums_.data() + size_t(y) * rowLength_;
+                for (size_t i = left; i < right; ++i) row[i] += above[i];
+            }
+        });
+    }
+
+    bool isNull() const { return sums_.empty(); }
+    QRect rect() const { return QRect(0, 0, width_, height_); }
+    size_t sizeInBytes() const { return sums_.size() * sizeof(quint32); }
+
+    // box must lie inside rect()
+    QRgb average(const QRect& box) const {
+        const quint32* top = sums_.data() + size_t(box.top()) * rowLength_;
+        const quint32* bottom = sums_.data() + size_t(box.bottom() + 1) * rowLength_;
+        const size_t left = size_t(box.left()) * 3;
+        const size_t right = size_t(box.right() + 1) * 3;
+        const quint32 count = quint32(box.width()) * quint32(box.height());
+
+        int channel[3];
+        for (int c = 0; c < 3; ++c) {
+            quint32 sum = bottom[right + c] - bottom[left + c] - top[right + c] + top[left + c];
+            channel[c] = int((sum + count / 2) / count);
+        }
+        return qRgb(channel[0], channel[1], channel[2]);
+    }
+
+   private:
+    static constexpr int kBandRows = 64;
+    static constexpr size_t kBandColumns = 3 * 256;
+
+    std::vector<quint32> sums_;
+    int width_ = 0;
+    int height_ = 0;
+    size_t rowLength_ = 0;  // (width + 1) * 3 sums per row
+};
+
+// plain loop over the box, used until the summed-area table is ready
+QRgb averageBox(const PixelSampler& sampler, const QRect& box);
@@ -0,0 +1,371 @@
+#include "session.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtEndian>
+#include <cstring>
+#include <vector>
+
+#include "capture.h"
+#include "trace.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'P', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr int kHeaderSize = 8 + 3 * 4;
+// enough bands to keep every core busy on a 4K capture
+constexpr int kBandRows = 128;
+
+// QOI operations
+constexpr uchar kOpIndex = 0x00;
+constexpr uchar kOpDiff = 0x40;
+constexpr uchar kOpLuma = 0x80;
+constexpr uchar kOpRun = 0xc0;
+constexpr uchar kOpRgb = 0xfe;
+constexpr uchar kMask2 = 0xc0;
+constexpr int kMaxRun = 62;
+
+inline int qoiHash(QRgb p) {
+    return (qRed(p) * 3 + qGreen(p) * 5 + qBlue(p) * 7 + 255 * 11) % 64;
+}
+
+struct Band {
+    int first;
+    int last;
+    QByteArray data;
+};
+
+// one band as a QOI op stream; state starts fresh so bands are independent
+void encodeBand(const QImage& image, Band& band) {
+    const int width = image.width();
+    // at most 4 bytes per pixel (an RGB op)
+    band.data.resize(qsizetype(width) * (band.last - band.first) * 4);
+    uchar* out = reinterpret_cast<uchar*>(band.data.data());
+    uchar* p = out;
+
+    QRgb cache[64] = {};
+    QRgb previous = qRgb(0, 0, 0);
+    int run = 0;
+    for (int y = band.first; y < band.last; ++y) {
+        const QRgb* row = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const QRgb pixel = row[x] | 0xff000000;
+            if (pixel == previous) {
+                if (++run == kMaxRun) {
+                    *p++ = kOpRun | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                *p++ = kOpRun | (run - 1);
+                run = 0;
+            }
+
+            const int hash = qoiHash(pixel);
+            if (cache[hash] == pixel) {
+                *p++ = kOpIndex | hash;
+            } else {
+                cache[hash] = pixel;
+                const int dr = int(qRed(pixel)) - int(qRed(previous));
+                const int dg = int(qGreen(pixel)) - int(qGreen(previous));
+                const int db = int(qBlue(pixel)) - int(qBlue(previous));
+                // differences wrap around like the 8-bit channels they are
+                const int wr = qint8(dr), wg = qint8(dg), wb = qint8(db);
+                const int drg = wr - wg, dbg = wb - wg;
+                if (wr >= -2 && wr <= 1 && wg >= -2 && wg <= 1 && wb >= -2 && wb <= 1) {
+                    *p++ = kOpDiff | (wr + 2) << 4 | (wg + 2) << 2 | (wb + 2);
+                } else if (wg >= -32 && wg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    *p++ = kOpLuma | (wg + 32);
+                    *p++ = uchar((drg + 8) << 4 | (dbg + 8));
+                } else {
+                    *p++ = kOpRgb;
+                    *p++ = uchar(qRed(pixel));
+                    *p++ = uchar(qGreen(pixel));
+                    *p++ = uchar(qBlue(pixel));
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) *p++ = kOpRun | (run - 1);
+    band.data.resize(p - out);
+}
+
+bool decodeBand(const uchar* in, qint64 size, uchar* dst, qsizetype stride, int width, int rows) {
+    const uchar* end = in + size;
+    QRgb cache[64] = {};
+    QRgb pixel = qRgb(0, 0, 0);
+    int run = 0;
+    for (int y = 0; y < rows; ++y) {
+        QRgb* row = reinterpret_cast<QRgb*>(dst + y * stride);
+        for (int x = 0; x < width; ++x) {
+            if (run > 0) {
+                --run;
+                row[x] = pixel;
+                continue;
+            }
+            if (in >= end) return false;
+            const uchar op = *in++;
+            if (op == kOpRgb) {
+                if (end - in < 3) return false;
+                pixel = qRgb(in[0], in[1], in[2]);
+                in += 3;
+            } else if ((op & kMask2) == kOpIndex) {
+                pixel = cache[op];
+            } else if ((op & kMask2) == kOpDiff) {
+                pixel = qRgb((qRed(pixel) + ((op >> 4) & 3) - 2) & 0xff, (qGreen(pixel) + ((op >> 2) & 3) - 2) & 0xff,
+                             (qBlue(pixel) + (op & 3) - 2) & 0xff);
+            } else if ((op & kMask2) == kOpLuma) {
+                if (in >= end) return false;
+                const int dg = (op & 0x3f) - 32;
+                const uchar next = *in++;
+                pixel = qRgb((qRed(pixel) + dg - 8 + (next >> 4)) & 0xff, (qGreen(pixel) + dg) & 0xff,
+                             (qBlue(pixel) + dg - 8 + (next & 0x0f)) & 0xff);
+            } else if (op == 0xff) {
+                // RGBA, never written for an opaque capture
+                return false;
+            } else {
+                run = op & 0x3f;
+            }
+            cache[qoiHash(pixel)] = pixel;
+            row[x] = pixel;
+        }
+    }
+    return run == 0;
+}
+
+QJsonArray rectToJson(const QRect& rect) {
+    return QJsonArray{rect.x(), rect.y(), rect.width(), rect.height()};
+}
+
+QRect rectFromJson(const QJsonValue& value) {
+    const QJsonArray array = value.toArray();
+    if (array.size() != 4) return QRect();
+    return QRect(array[0].toInt(), array[1].toInt(), array[2].toInt(), array[3].toInt());
+}
+
+bool readSidecar(const QString& path, SessionInfo* info) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.value("version").toInt() != 1) return false;
+
+    info->id = root.value("id").toString();
+    info->time = QDateTime::fromString(root.value("time").toString(), Qt::ISODateWithMs);
+    info->geometry = rectFromJson(root.value("geometry"));
+    info->screens.clear();
+    for (const QJsonValue& screen : root.value("screens").toArray()) info->screens.append(rectFromJson(screen));
+    info->picks.clear();
+    for (const QJsonValue& value : root.value("picks").toArray()) {
+        const QJsonObject pick = value.toObject();
+        ColorFormat format = ColorFormat::HEX;
+        parseColorFormat(pick.value("format").toString(), &format);
+        info->picks.append({rectFromJson(pick.value("area")), pick.value("text").toString(), format});
+    }
+    return !info->id.isEmpty() && info->geometry.isValid();
+}
+
+}  // namespace
+
+bool encodeSnapshot(const QImage& image, QByteArray* out) {
+    Q_ASSERT(image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32);
+    std::vector<Band> bands;
+    for (int y = 0; y < image.height(); y += kBandRows) {
+        bands.push_back({y, qMin(image.height(), y + kBandRows), QByteArray()});
+    }
+    QtConcurrent::blockingMap(bands, [&image](Band& band) { encodeBand(image, band); });
+
+    const qsizetype tableSize = qsizetype(bands.size() + 1) * 8;
+    qsizetype total = kHeaderSize + tableSize;
+    for (const Band& band : bands) total += band.data.size();
+    out->resize(total);
+
+    uchar* p = reinterpret_cast<uchar*>(out->data());
+    memcpy(p, kMagic, 8);
+    qToLittleEndian<quint32>(quint32(image.width()), p + 8);
+    qToLittleEndian<quint32>(quint32(image.height()), p + 12);
+    qToLittleEndian<quint32>(quint32(bands.size()), p + 16);
+    uchar* table = p + kHeaderSize;
+    uchar* data = table + tableSize;
+    quint64 offset = 0;
+    for (size_t i = 0; i < bands.size(); ++i) {
+        qToLittleEndian<quint64>(offset, table + i * 8);
+        memcpy(data + offset, bands[i].data.constData(), size_t(bands[i].data.size()));
+        offset += quint64(bands[i].data.size());
+    }
+    qToLittleEndian<quint64>(offset, table + bands.size() * 8);
+    return true;
+}
+
+bool decodeSnapshot(const uchar* data, qint64 size, QImage& image) {
+    if (size < kHeaderSize || memcmp(data, kMagic, 8) != 0) return false;
+    const quint32 width = qFromLittleEndian<quint32>(data + 8);
+    const quint32 height = qFromLittleEndian<quint32>(data + 12);
+    const quint32 bandCount = qFromLittleEndian<quint32>(data + 16);
+    if (width == 0 || height == 0 || width > 65535 || height > 65535) return false;
+    if (bandCount != (height + kBandRows - 1) / kBandRows) return false;
+    const qint64 tableSize = qint64(bandCount + 1) * 8;
+    if (size < kHeaderSize + tableSize) return false;
+
+    const uchar* table = data + kHeaderSize;
+    const uchar* payload = table + tableSize;
+    const qint64 payloadSize = size - kHeaderSize - tableSize;
+
+    struct Slice {
+        const uchar* data;
+        qint64 size;
+        int first;
+        int last;
+        bool ok;
+    };
+    std::vector<Slice> slices(bandCount);
+    for (quint32 i = 0; i < bandCount; ++i) {
+        const quint64 begin = qFromLittleEndian<quint64>(table + i * 8);
+        const quint64 end = qFromLittleEndian<quint64>(table + (i + 1) * 8);
+        if (begin > end || end > quint64(payloadSize)) return false;
+        slices[i] = {payload + begin, qint64(end - begin), int(i) * kBandRows,
+                     qMin(int(height), int(i + 1) * kBandRows), false};
+    }
+
+    ensureCaptureBuffer(image, QSize(int(width), int(height)));
+    // raw pointer, the workers must not go through QImage's detach logic
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+    QtConcurrent::blockingMap(slices, [bits, stride, width](Slice& slice) {
+        slice.ok = decodeBand(slice.data, slice.size, bits + slice.first * stride, stride, int(width),
+                              slice.last - slice.first);
+    });
+    for (const Slice& slice : slices) {
+        if (!slice.ok) return false;
+    }
+    return true;
+}
+
+SessionStore::SessionStore(const QString& directory, int capacity) : directory_(directory), capacity_(capacity) {
+    writer_.setMaxThreadCount(1);
+}
+
+SessionStore::~SessionStore() {
+    // a session saved just before quitting still lands on disk
+    writer_.waitForDone();
+}
+
+QString SessionStore::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/colorpicker/sessions";
+}
+
+QString SessionStore::imagePath(const QString& id) const {
+    return directory_ + "/" + id + ".snap";
+}
+
+QString SessionStore::sidecarPath(const QString& id) const {
+    return directory_ + "/" + id + ".json";
+}
+
+QList<SessionInfo> SessionStore::list() const {
+    QList<SessionInfo> sessions;
+    // ids are timestamps, so reverse name order is newest first
+    const QStringList names = QDir(directory_).entryList({"*.json"}, QDir::Files, QDir::Name | QDir::Reversed);
+    for (const QString& name : names) {
+        SessionInfo info;
+        if (readSidecar(directory_ + "/" + name, &info)) sessions.append(info);
+    }
+    return sessions;
+}
+
+QFuture<bool> SessionStore::save(const QImage& capture, const SessionInfo& info) {
+    return QtConcurrent::run(&writer_, [this, capture, info]() {
+        TraceSpan span("save session");
+        span.setDetail(info.id);
+        QElapsedTimer timer;
+        timer.start();
+        if (!QDir().mkpath(directory_)) return false;
+
+        QByteArray encoded;
+        encodeSnapshot(capture, &encoded);
+        QSaveFile file(imagePath(info.id));
+        if (!file.open(QIODevice::WriteOnly) || file.write(encoded) != encoded.size() || !file.commit()) {
+            qWarning().noquote() << QString("session %1: %2").arg(info.id, file.errorString());
+            return false;
+        }
+        if (!writeSidecar(info)) return false;
+        qInfo().noquote() << QString("session %1 saved: %2 MB in %3 ms")
+                                 .arg(info.id)
+                                 .arg(encoded.size() / 1048576.0, 0, 'f', 1)
+                                 .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1);
+        trim();
+        return true;
+    });
+}
+
+QFuture<bool> SessionStore::updatePicks(const SessionInfo& info) {
+    return QtConcurrent::run(&writer_, [this, info]() { return writeSidecar(info); });
+}
+
+bool SessionStore::writeSidecar(const SessionInfo& info) const {
+    QJsonArray screens;
+    for (const QRect& screen : info.screens) screens.append(rectToJson(screen));
+    QJsonArray picks;
+    for (const SessionPick& pick : info.picks) {
+        QJsonObject object;
+        object["area"] = rectToJson(pick.area);
+        object["text"] = pick.text;
+        object["format"] = colorFormatName(pick.format);
+        picks.append(object);
+    }
+    QJsonObject root;
+    root["version"] = 1;
+    root["id"] = info.id;
+    root["time"] = info.time.toString(Qt::ISODateWithMs);
+    root["geometry"] = rectToJson(info.geometry);
+    root["screens"] = screens;
+    root["picks"] = picks;
+    root["image"] = info.id + ".snap";
+
+    QSaveFile file(sidecarPath(info.id));
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson()) < 0 || !file.commit()) {
+        qWarning().noquote() << QString("session %1: %2").arg(info.id, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+// the oldest sessions beyond capacity, and snapshots whose sidecar never made it
+void SessionStore::trim() const {
+    QDir dir(directory_);
+    const QStringList sidecars = dir.entryList({"*.json"}, QDir::Files, QDir::Name | QDir::Reversed);
+    for (int i = capacity_; i < sidecars.size(); ++i) {
+        const QString id = QFileInfo(sidecars[i]).completeBaseName();
+        QFile::remove(imagePath(id));
+        QFile::remove(sidecarPath(id));
+    }
+    for (const QString& name : dir.entryList({"*.snap"}, QDir::Files)) {
+        if (!QFile::exists(sidecarPath(QFileInfo(name).completeBaseName()))) dir.remove(name);
+    }
+}
+
+bool SessionStore::load(const QString& id, QImage& capture, SessionInfo* info) const {
+    if (!readSidecar(sidecarPath(id), info)) return false;
+
+    QFile file(imagePath(id));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    TraceSpan span("load session");
+    span.setDetail(id);
+    // decoded straight out of the page cache, no read buffer in between
+    const uchar* mapped = file.map(0, file.size());
+    if (!mapped) return false;
+    const bool ok = decodeSnapshot(mapped, file.size(), capture);
+    file.unmap(const_cast<uchar*>(mapped));
+    return ok && capture.size() == info->geometry.size();
+}
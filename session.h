@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QDateTime>
+#include <QFuture>
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QString>
+#include <QThreadPool>
+
+#include "colorformat.h"
+
+// Snapshot image coding: QOI operations (runs, a 64-entry color cache, small
+// deltas) over the capture's rows, cut into bands that are coded
+// independently so encoding and decoding both run on every core. Lossless,
+// and an order of magnitude faster than PNG. Layout, little-endian:
+//   "CPSNAP01", u32 width, u32 height, u32 bands, u64 offsets[bands + 1], data
+bool encodeSnapshot(const QImage& image, QByteArray* out);
+
+// decodes into image (RGB32), reusing its allocation when the size fits;
+// false on a truncated or corrupt file
+bool decodeSnapshot(const uchar* data, qint64 size, QImage& image);
+
+// one pick made in a session, virtual desktop coordinates; a palette pick
+// covers its selection
+struct SessionPick {
+    QRect area;
+    QString text;
+    ColorFormat format;
+};
+
+struct SessionInfo {
+    QString id;  // also the file name stem, sorts by time
+    QDateTime time;
+    QRect geometry;  // virtual desktop the capture covers
+    QList<QRect> screens;
+    QList<SessionPick> picks;
+};
+
+// Recent pick sessions on disk: the snapshot plus a JSON sidecar per
+// session, in a ring that keeps the newest `capacity`. Saves run one at a
+// time on a background thread; the sidecar is written last, so listing
+// never sees a half-written session.
+class SessionStore {
+   public:
+    SessionStore(const QString& directory, int capacity);
+    ~SessionStore();
+
+    // $XDG_CACHE_HOME/colorpicker/sessions
+    static QString defaultDirectory();
+
+    // most recent first
+    QList<SessionInfo> list() const;
+
+    // capture is shared, not copied, unless the caller writes to it meanwhile
+    QFuture<bool> save(const QImage& capture, const SessionInfo& info);
+
+    // rewrites only the sidecar, for picks made after a reopen
+    QFuture<bool> updatePicks(const SessionInfo& info);
+
+    // maps the snapshot and decodes it into capture
+    bool load(const QString& id, QImage& capture, SessionInfo* info) const;
+
+   private:
+    QString imagePath(const QString& id) const;
+    QString sidecarPath(const QString& id) const;
+    bool writeSidecar(const SessionInfo& info) const;
+    void trim() const;
+
+    QString directory_;
+    int capacity_;
+    QThreadPool writer_;  // one thread, saves and trimming never overlap
+};
@@ -0,0 +1,108 @@
+#include <QTest>
+
+#include "colorformat.h"
+
+Q_DECLARE_METATYPE(ColorFormat)
+
+namespace {
+
+// the formats formatColorReference() covers, the rest are newer
+const ColorFormat kReferenceFormats[] = {
+    ColorFormat::HTML, ColorFormat::HEX,      ColorFormat::DelphiHex, ColorFormat::VBHex, ColorFormat::RGBA,
+    ColorFormat::RGB,  ColorFormat::RGBFloat, ColorFormat::HSV,       ColorFormat::HSL,
+};
+
+const ColorFormat kAllFormats[] = {
+    ColorFormat::HTML, ColorFormat::HEX,      ColorFormat::DelphiHex, ColorFormat::VBHex, ColorFormat::RGBA,
+    ColorFormat::RGB,  ColorFormat::RGBFloat, ColorFormat::HSV,       ColorFormat::HSL,   ColorFormat::Lab,
+    ColorFormat::OKLab, ColorFormat::OKLCH,   ColorFormat::CMYK,
+};
+
+// Every value of each channel with the others swept in steps, the greys where
+// hue is undefined, and a deterministic spread of the rest of the cube.
+// The bench's --verify-all walks all 16.7M colors, too slow for every build.
+QList<QRgb> testColors() {
+    QList<QRgb> colors;
+    for (int v = 0; v < 256; ++v) {
+        colors << qRgb(v, v, v);
+        for (int other = 0; other < 256; other += 15) {
+            colors << qRgb(v, other, 255 - other) << qRgb(other, v, 255 - other) << qRgb(other, 255 - other, v);
+        }
+    }
+    quint32 state = 0x9e3779b9;
+    for (int i = 0; i < 200000; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        colors << (0xff000000 | state);
+    }
+    return colors;
+}
+
+}  // namespace
+
+class ColorFormatTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void matchesReference_data() {
+        QTest::addColumn<ColorFormat>("format");
+        for (ColorFormat format : kReferenceFormats) {
+            QTest::newRow(qPrintable(colorFormatName(format))) << format;
+        }
+    }
+
+    // byte for byte what the QString::arg() formatter produced
+    void matchesReference() {
+        QFETCH(ColorFormat, format);
+        QList<QRgb> colors = testColors();
+        // alpha only shows up in rgba, the other formats ignore it
+        if (format == ColorFormat::RGBA) {
+            for (int a = 0; a < 256; ++a) colors << qRgba(0x80, 0x40, 0xc0, a);
+        }
+        for (QRgb rgba : colors) {
+            const QColor color = QColor::fromRgba(rgba);
+            const QString actual = formatColor(color, format);
+            const QString expected = formatColorReference(color, format);
+            if (actual != expected) {
+                QFAIL(qPrintable(QString("#%1: \"%2\", expected \"%3\"")
+                                     .arg(rgba, 8, 16, QChar('0'))
+                                     .arg(actual, expected)));
+            }
+        }
+    }
+
+    void fitsBuffer_data() {
+        QTest::addColumn<ColorFormat>("format");
+        for (ColorFormat format : kAllFormats) {
+            QTest::newRow(qPrintable(colorFormatName(format))) << format;
+        }
+    }
+
+    // no format needs more than kMaxLength chars
+    void fitsBuffer() {
+        QFETCH(ColorFormat, format);
+        const ColorFormatter& formatter = ColorFormatter::instance();
+        char buffer[ColorFormatter::kMaxLength];
+        for (QRgb rgba : testColors()) {
+            const int length = formatter.format(rgba, format, buffer);
+            QVERIFY(length > 0 && length <= ColorFormatter::kMaxLength);
+        }
+    }
+
+    // the command line names map back to their formats
+    void names() {
+        for (ColorFormat format : kAllFormats) {
+            const QString name = colorFormatName(format);
+            QVERIFY(!name.isEmpty());
+            ColorFormat parsed = ColorFormat::HEX;
+            QVERIFY(parseColorFormat(name.toUpper(), &parsed));
+            QVERIFY(parsed == format);
+        }
+        ColorFormat parsed;
+        QVERIFY(!parseColorFormat("rgbx", &parsed));
+    }
+};
+
+QTEST_GUILESS_MAIN(ColorFormatTest)
+#include "colorformat_test.moc"
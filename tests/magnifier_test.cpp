@@ -0,0 +1,226 @@
+#include <QImage>
+#include <QTest>
+
+#include "magnifier.h"
+
+Q_DECLARE_METATYPE(MagnifierKernel)
+
+namespace {
+
+constexpr QRgb kSentinel = 0xff123456;
+
+// every pixel differs from its neighbours, so an off-by-one shows
+QImage noiseImage(int width, int height) {
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 state = 0x9e3779b9;
+    for (int y = 0; y < height; ++y) {
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            row[x] = 0xff000000 | (state >> 8);
+        }
+    }
+    return image;
+}
+
+// The capture is a view into a wider buffer, like an overlay's screen in the
+// virtual desktop, so its stride is not width * 4
+struct Source {
+    QImage backing = noiseImage(130, 80);
+    QImage view{backing.constBits() + 5 * backing.bytesPerLine() + 9 * 4, 97, 61, backing.bytesPerLine(),
+                QImage::Format_RGB32};
+};
+
+// what the magnifier drew before the kernel
+QImage reference(const QImage& source, const QRect& rect, int zoom) {
+    return source.copy(rect).scaled(rect.width() * zoom, rect.height() * zoom, Qt::IgnoreAspectRatio,
+                                    Qt::FastTransformation);
+}
+
+// rect zoomed into a destination wider and taller than needed, pre-filled so
+// writes past the zoomed area show up
+QImage magnify(const QImage& source, const QRect& rect, int zoom, const MagnifierOptions& options) {
+    QImage dst(rect.width() * zoom + 7, rect.height() * zoom + 3, QImage::Format_RGB32);
+    dst.fill(kSentinel);
+    magnifyNearest(reinterpret_cast<const QRgb*>(source.constScanLine(rect.y())) + rect.x(), source.bytesPerLine(),
+                   rect.width(), rect.height(), zoom, reinterpret_cast<QRgb*>(dst.bits()), dst.bytesPerLine(),
+                   options);
+    return dst;
+}
+
+// first differing pixel of the zoomed area, or an empty string
+QString compare(const QImage& actual, const QImage& expected) {
+    for (int y = 0; y < actual.height(); ++y) {
+        const QRgb* row = reinterpret_cast<const QRgb*>(actual.constScanLine(y));
+        for (int x = 0; x < actual.width(); ++x) {
+            const bool inside = x < expected.width() && y < expected.height();
+            const QRgb want = inside ? expected.pixel(x, y) : kSentinel;
+            if (row[x] != want) {
+                return QString("(%1, %2): %3, expected %4")
+                    .arg(x)
+                    .arg(y)
+                    .arg(row[x], 8, 16, QChar('0'))
+                    .arg(want, 8, 16, QChar('0'));
+            }
+        }
+    }
+    return QString();
+}
+
+// the magnifier's source rects: odd sides around a cursor, clipped at the
+// screen edges and corners
+QList<QRect> sourceRects(const QRect& bounds) {
+    QList<QRect> rects;
+    const QPoint cursors[] = {bounds.center(), bounds.topLeft(), bounds.bottomRight(), bounds.topRight(),
+                              bounds.bottomLeft(), QPoint(bounds.center().x(), bounds.bottom())};
+    for (int side : {1, 3, 11, 13, 25, 75}) {
+        for (const QPoint& cursor : cursors) {
+            const int radius = side / 2;
+            rects << QRect(cursor.x() - radius, cursor.y() - radius, side, side).intersected(bounds);
+        }
+    }
+    return rects;
+}
+
+QString kernelName(MagnifierKernel kernel) {
+    switch (kernel) {
+        case MagnifierKernel::Auto: return "auto";
+        case MagnifierKernel::Scalar: return "scalar";
+        case MagnifierKernel::Sse2: return "sse2";
+        case MagnifierKernel::Avx2: return "avx2";
+    }
+    return QString();
+}
+
+}  // namespace
+
+class MagnifierTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void matchesScaled_data() {
+        QTest::addColumn<MagnifierKernel>("kernel");
+        QTest::addColumn<int>("zoom");
+        for (MagnifierKernel kernel :
+             {MagnifierKernel::Auto, MagnifierKernel::Scalar, MagnifierKernel::Sse2, MagnifierKernel::Avx2}) {
+            for (int zoom = kMinZoom; zoom <= kMaxZoom; ++zoom) {
+                QTest::addRow("%s x%d", qPrintable(kernelName(kernel)), zoom) << kernel << zoom;
+            }
+        }
+    }
+
+    // pixel for pixel what copy() + scaled(FastTransformation) produced
+    void matchesScaled() {
+        QFETCH(MagnifierKernel, kernel);
+        QFETCH(int, zoom);
+        if (!magnifierKernelAvailable(kernel)) QSKIP("kernel not available on this build or CPU");
+
+        const Source source;
+        MagnifierOptions options;
+        options.kernel = kernel;
+        for (const QRect& rect : sourceRects(source.view.rect())) {
+            const QString error = compare(magnify(source.view, rect, zoom, options), reference(source.view, rect, zoom));
+            QVERIFY2(error.isEmpty(), qPrintable(QString("rect %1,%2 %3x%4 at %5")
+                                                     .arg(rect.x())
+                                                     .arg(rect.y())
+                                                     .arg(rect.width())
+                                                     .arg(rect.height())
+                                                     .arg(error)));
+        }
+    }
+
+    void gridAndMarker_data() { matchesScaled_data(); }
+
+    // the grid replaces the first row and column of every cell, the marker a
+    // border inside the marked cell; everything else is the plain zoom
+    void gridAndMarker() {
+        QFETCH(MagnifierKernel, kernel);
+        QFETCH(int, zoom);
+        if (!magnifierKernelAvailable(kernel)) QSKIP("kernel not available on this build or CPU");
+
+        const Source source;
+        const QRect rect(40, 20, 13, 11);
+        MagnifierOptions options;
+        options.kernel = kernel;
+        options.grid = true;
+        options.marker = QPoint(6, 5);
+
+        QImage expected = reference(source.view, rect, zoom);
+        const int border = qMin(options.markerWidth, zoom / 2);
+        for (int y = 0; y < expected.height(); ++y) {
+            for (int x = 0; x < expected.width(); ++x) {
+                const QPoint cell(x / zoom, y / zoom);
+                const int ix = x % zoom;
+                const int iy = y % zoom;
+                const bool onBorder = ix < border || iy < border || ix >= zoom - border || iy >= zoom - border;
+                if (cell == options.marker && onBorder) {
+                    expected.setPixel(x, y, options.markerColor);
+                } else if (ix == 0 || iy == 0) {
+                    expected.setPixel(x, y, magnifierGridPixel(expected.pixel(x, y)));
+                }
+            }
+        }
+        const QString error = compare(magnify(source.view, rect, zoom, options), expected);
+        QVERIFY2(error.isEmpty(), qPrintable(error));
+    }
+
+    // every tile is the zoom of its (clipped) source rect, and comes back
+    // from the cache the second time
+    void tileCache() {
+        const Source source;
+        const PixelSampler sampler(source.view);
+        for (int zoom : {2, 5, 12, 32}) {
+            for (bool grid : {false, true}) {
+                MagnifierTileCache cache;
+                cache.setSource(sampler);
+                const int side = MagnifierTileCache::tilePixels(zoom);
+                for (int ty = 0; ty * side < source.view.height(); ++ty) {
+                    for (int tx = 0; tx * side < source.view.width(); ++tx) {
+                        QRect tileRect;
+                        const QImage& cached = cache.tile(zoom, grid, QPoint(tx, ty), &tileRect);
+                        QCOMPARE(tileRect, QRect(tx * side, ty * side, side, side).intersected(source.view.rect()));
+                        const QImage tile = cached.copy(0, 0, tileRect.width() * zoom, tileRect.height() * zoom);
+                        MagnifierOptions options;
+                        options.grid = grid;
+                        const QImage expected =
+                            magnify(source.view, tileRect, zoom, options).copy(0, 0, tile.width(), tile.height());
+                        QCOMPARE(tile, expected);
+                        if (!grid) QCOMPARE(tile, reference(source.view, tileRect, zoom));
+
+                        const qint64 hits = cache.hits();
+                        cache.tile(zoom, grid, QPoint(tx, ty), &tileRect);
+                        QCOMPARE(cache.hits(), hits + 1);
+                    }
+                }
+            }
+        }
+    }
+
+    // a full pool hands the least recently used slot to the next miss, which
+    // is zoomed afresh into it
+    void tileCacheRecycles() {
+        const Source source;
+        const PixelSampler sampler(source.view);
+        const int zoom = 16;
+        MagnifierTileCache cache(2 * MagnifierTileCache::kTileSide * MagnifierTileCache::kTileSide * 4);
+        cache.setSource(sampler);
+
+        QRect tileRect;
+        cache.tile(zoom, false, QPoint(0, 0), &tileRect);
+        cache.tile(zoom, false, QPoint(1, 0), &tileRect);
+        cache.tile(zoom, false, QPoint(0, 0), &tileRect);
+        QCOMPARE(cache.hits(), qint64(1));
+
+        // evicts (1, 0), the one not used last
+        const QImage& recycled = cache.tile(zoom, false, QPoint(2, 1), &tileRect);
+        QCOMPARE(recycled.copy(0, 0, tileRect.width() * zoom, tileRect.height() * zoom),
+                 reference(source.view, tileRect, zoom));
+        cache.tile(zoom, false, QPoint(0, 0), &tileRect);
+        QCOMPARE(cache.hits(), qint64(2));
+        cache.tile(zoom, false, QPoint(1, 0), &tileRect);
+        QCOMPARE(cache.misses(), qint64(4));
+    }
+};
+
+QTEST_GUILESS_MAIN(MagnifierTest)
+#include "magnifier_test.moc"
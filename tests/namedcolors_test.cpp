@@ -0,0 +1,133 @@
+#include <QTemporaryFile>
+#include <QTest>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "namedcolors.h"
+
+namespace {
+
+std::vector<NamedColor> randomColors(int count, quint32 seed) {
+    std::vector<NamedColor> colors;
+    quint32 state = seed;
+    for (int i = 0; i < count; ++i) {
+        state = state * 1664525u + 1013904223u;
+        colors.push_back({QString("color %1").arg(i), qRgb(state >> 24, state >> 16 & 0xff, state >> 8 & 0xff)});
+    }
+    return colors;
+}
+
+// distance to the closest entry by a scan over all of them
+float linearNearest(const std::vector<NamedColor>& colors, QRgb color) {
+    const ColorFormatter& formatter = ColorFormatter::instance();
+    float lab[3];
+    formatter.toOklab(qRed(color), qGreen(color), qBlue(color), lab);
+    float best = std::numeric_limits<float>::max();
+    for (const NamedColor& entry : colors) {
+        float entryLab[3];
+        formatter.toOklab(qRed(entry.color), qGreen(entry.color), qBlue(entry.color), entryLab);
+        const float d0 = lab[0] - entryLab[0];
+        const float d1 = lab[1] - entryLab[1];
+        const float d2 = lab[2] - entryLab[2];
+        best = std::min(best, std::sqrt(d0 * d0 + d1 * d1 + d2 * d2));
+    }
+    return best;
+}
+
+NamedColorIndex loadText(const QByteArray& text) {
+    QTemporaryFile file;
+    if (!file.open()) return NamedColorIndex();
+    file.write(text);
+    file.close();
+    return NamedColorIndex::load(file.fileName());
+}
+
+}  // namespace
+
+class NamedColorsTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void matchesLinearScan_data() {
+        QTest::addColumn<int>("entries");
+        // within one leaf, just past one, and deep trees
+        for (int entries : {1, 2, 8, 9, 17, 100, 5000}) QTest::addRow("%d", entries) << entries;
+    }
+
+    // ties may resolve to another entry, so distances are compared
+    void matchesLinearScan() {
+        QFETCH(int, entries);
+        const std::vector<NamedColor> colors = randomColors(entries, 0x1234567u + entries);
+        const NamedColorIndex index(colors);
+        QCOMPARE(index.size(), entries);
+
+        quint32 state = 0x9e3779b9;
+        for (int i = 0; i < 4000; ++i) {
+            state = state * 1664525u + 1013904223u;
+            const QRgb query = qRgb(state >> 24, state >> 16 & 0xff, state >> 8 & 0xff);
+            float distance = -1;
+            const int found = index.nearest(query, &distance);
+            QVERIFY(found >= 0 && found < entries);
+            const float expected = linearNearest(colors, query);
+            QVERIFY2(std::abs(distance - expected) <= 1e-6f, qPrintable(QString("#%1: %2, expected %3")
+                                                                            .arg(query, 8, 16, QChar('0'))
+                                                                            .arg(distance)
+                                                                            .arg(expected)));
+        }
+    }
+
+    void exactEntries() {
+        const std::vector<NamedColor> colors = randomColors(300, 42);
+        const NamedColorIndex index(colors);
+        for (const NamedColor& entry : colors) {
+            float distance = -1;
+            const int found = index.nearest(entry.color, &distance);
+            QCOMPARE(index.at(found).color, entry.color);
+            QCOMPARE(distance, 0.0f);
+        }
+        QCOMPARE(NamedColorIndex().nearest(qRgb(1, 2, 3)), -1);
+    }
+
+    void loadsLineFormats() {
+        const NamedColorIndex index = loadText("// comment\n"
+                                               "# comment\n"
+                                               "brand red #FF0000\n"
+                                               "#00ff00 signal green\n"
+                                               "  --token-blue: #00F;\n"
+                                               "255 255 0\tgimp yellow\n"
+                                               "no color here\n");
+        QCOMPARE(index.size(), 4);
+        QCOMPARE(index.at(0).name, QString("brand red"));
+        QCOMPARE(index.at(0).color, qRgb(255, 0, 0));
+        QCOMPARE(index.at(1).name, QString("signal green"));
+        QCOMPARE(index.at(1).color, qRgb(0, 255, 0));
+        QCOMPARE(index.at(2).name, QString("--token-blue"));
+        QCOMPARE(index.at(2).color, qRgb(0, 0, 255));
+        QCOMPARE(index.at(3).name, QString("gimp yellow"));
+        QCOMPARE(index.at(3).color, qRgb(255, 255, 0));
+    }
+
+    void loadsJsonTokens() {
+        const NamedColorIndex index = loadText(R"({"color": {"brand": {"primary": {"$value": "#112233"}},
+                                                             "accent": "#445566"}})");
+        QCOMPARE(index.size(), 2);
+        QStringList names;
+        for (int i = 0; i < index.size(); ++i) names << index.at(i).name;
+        names.sort();
+        QCOMPARE(names, QStringList({"color.accent", "color.brand.primary"}));
+    }
+
+    // what a pick copies in each mode
+    void pickedText() {
+        const NamedColorIndex index({{"ink", qRgb(10, 10, 10)}, {"paper", qRgb(250, 250, 250)}});
+        const QRgb color = qRgb(20, 12, 8);
+        QCOMPARE(formatPickedColor(color, ColorFormat::HEX, &index, NamedColorMode::Show), QString("#140C08"));
+        QCOMPARE(formatPickedColor(color, ColorFormat::HEX, &index, NamedColorMode::SnapColor), QString("#0A0A0A"));
+        QCOMPARE(formatPickedColor(color, ColorFormat::HEX, &index, NamedColorMode::CopyName), QString("ink"));
+        QCOMPARE(formatPickedColor(color, ColorFormat::HEX, nullptr, NamedColorMode::CopyName), QString("#140C08"));
+    }
+};
+
+QTEST_GUILESS_MAIN(NamedColorsTest)
+#include "namedcolors_test.moc"
@@ -0,0 +1,117 @@
+#include <QImage>
+#include <QTest>
+#include <algorithm>
+
+#include "palette.h"
+
+namespace {
+
+// vertical stripes of colors, widths in proportion to weights; colors far
+// apart, so every clustering ends with each of them on its own
+QImage stripes(int width, int height, const QList<QRgb>& colors, const QList<int>& weights) {
+    QImage image(width, height, QImage::Format_RGB32);
+    int total = 0;
+    for (int weight : weights) total += weight;
+    int x = 0;
+    for (int i = 0; i < colors.size(); ++i) {
+        const int end = i + 1 == colors.size() ? width : x + width * weights[i] / total;
+        for (int y = 0; y < height; ++y) {
+            QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+            std::fill(row + x, row + end, colors[i]);
+        }
+        x = end;
+    }
+    return image;
+}
+
+qint64 totalPixels(const std::vector<PaletteColor>& palette) {
+    qint64 total = 0;
+    for (const PaletteColor& entry : palette) total += entry.pixels;
+    return total;
+}
+
+const QList<QRgb> kColors = {qRgb(220, 30, 40), qRgb(20, 40, 200), qRgb(250, 240, 230), qRgb(10, 120, 30)};
+const QList<int> kWeights = {4, 3, 2, 1};
+
+}  // namespace
+
+class PaletteTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void exactColors_data() {
+        QTest::addColumn<QSize>("size");
+        // one band, and enough samples for a band per core
+        QTest::newRow("small") << QSize(100, 40);
+        QTest::newRow("parallel") << QSize(1000, 700);
+    }
+
+    // the colors themselves, most common first, with their pixel counts
+    void exactColors() {
+        QFETCH(QSize, size);
+        const QImage image = stripes(size.width(), size.height(), kColors, kWeights);
+        const PixelSampler sampler(image);
+        const std::vector<PaletteColor> palette = extractPalette(sampler, image.rect(), 4);
+
+        QCOMPARE(int(palette.size()), 4);
+        for (int i = 0; i < 4; ++i) {
+            QCOMPARE(palette[i].color, kColors[i]);
+            QCOMPARE(palette[i].pixels, qint64(size.width() * kWeights[i] / 10) * size.height());
+        }
+    }
+
+    // no more entries than distinct colors, however many were asked for
+    void fewerColorsThanAsked() {
+        const QImage image = stripes(64, 64, kColors, kWeights);
+        const PixelSampler sampler(image);
+        const std::vector<PaletteColor> palette = extractPalette(sampler, image.rect(), 16);
+        QCOMPARE(int(palette.size()), 4);
+        QCOMPARE(totalPixels(palette), qint64(64 * 64));
+    }
+
+    // a noisy region still accounts for every sample, and sorts by count
+    void countsEverySample() {
+        QImage image(333, 211, QImage::Format_RGB32);
+        quint32 state = 0x9e3779b9;
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                state = state * 1664525u + 1013904223u;
+                row[x] = 0xff000000 | (state >> 8);
+            }
+        }
+        const PixelSampler sampler(image);
+        for (int step : {1, 2, 7}) {
+            const std::vector<PaletteColor> palette = extractPalette(sampler, image.rect(), 5, step);
+            QCOMPARE(int(palette.size()), 5);
+            const qint64 samples = qint64((image.width() + step - 1) / step) * ((image.height() + step - 1) / step);
+            QCOMPARE(totalPixels(palette), samples);
+            for (size_t i = 1; i < palette.size(); ++i) QVERIFY(palette[i - 1].pixels >= palette[i].pixels);
+        }
+    }
+
+    // only the part of the region on the image counts
+    void clipsRegion() {
+        const QImage image = stripes(100, 50, kColors, kWeights);
+        const PixelSampler sampler(image);
+        // the first stripe only, hanging off the left and bottom edges
+        const std::vector<PaletteColor> palette = extractPalette(sampler, QRect(-20, 30, 60, 40), 3);
+        QCOMPARE(int(palette.size()), 1);
+        QCOMPARE(palette[0].color, kColors[0]);
+        QCOMPARE(palette[0].pixels, qint64(40 * 20));
+
+        QVERIFY(extractPalette(sampler, QRect(200, 0, 10, 10), 3).empty());
+        QVERIFY(extractPalette(sampler, image.rect(), 0).empty());
+    }
+
+    void step() {
+        QCOMPARE(paletteStep(QRect(0, 0, 512, 512)), 1);
+        QCOMPARE(paletteStep(QRect(0, 0, 3840, 2160)), 6);
+        const QRect desktop(0, 0, 7680, 4320);
+        const int step = paletteStep(desktop);
+        QVERIFY(double(desktop.width() / step) * (desktop.height() / step) <= 1 << 18);
+    }
+};
+
+QTEST_GUILESS_MAIN(PaletteTest)
+#include "palette_test.moc"
@@ -0,0 +1,192 @@
+#include <QImage>
+#include <QTest>
+#include <QtEndian>
+#include <utility>
+
+#include "capture.h"
+#include "session.h"
+
+namespace {
+
+constexpr int kHeaderSize = 8 + 3 * 4;
+
+// what each QOI op is good at: misses, runs, small steps and cache hits
+enum class Pattern { Noise, Flat, Gradient, Alternating };
+
+QImage patternImage(Pattern pattern, int width, int height) {
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 state = 0x9e3779b9;
+    const QRgb pair[2] = {qRgb(200, 10, 90), qRgb(30, 160, 250)};
+    for (int y = 0; y < height; ++y) {
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            switch (pattern) {
+                case Pattern::Noise:
+                    state = state * 1664525u + 1013904223u;
+                    row[x] = 0xff000000 | (state >> 8);
+                    break;
+                case Pattern::Flat:
+                    // long runs that cross rows, with the odd break
+                    row[x] = (x + y * width) % 97 == 0 ? qRgb(1, 2, 3) : qRgb(40, 40, 40);
+                    break;
+                case Pattern::Gradient: row[x] = qRgb(x * 3 & 0xff, y & 0xff, (x + y) / 2 & 0xff); break;
+                case Pattern::Alternating: row[x] = pair[(x / 3 + y) & 1]; break;
+            }
+        }
+    }
+    return image;
+}
+
+QByteArray encoded(const QImage& image) {
+    QByteArray out;
+    encodeSnapshot(image, &out);
+    return out;
+}
+
+bool decode(const QByteArray& data, QImage& image) {
+    return decodeSnapshot(reinterpret_cast<const uchar*>(data.constData()), data.size(), image);
+}
+
+uchar* bytes(QByteArray& data) {
+    return reinterpret_cast<uchar*>(data.data());
+}
+
+}  // namespace
+
+Q_DECLARE_METATYPE(Pattern)
+
+class SnapshotTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void roundTrip_data() {
+        QTest::addColumn<Pattern>("pattern");
+        QTest::addColumn<QSize>("size");
+        const std::pair<Pattern, const char*> patterns[] = {{Pattern::Noise, "noise"},
+                                                            {Pattern::Flat, "flat"},
+                                                            {Pattern::Gradient, "gradient"},
+                                                            {Pattern::Alternating, "alternating"}};
+        // one pixel, odd sizes, one band exactly, and a partial last band
+        for (const auto& [pattern, name] : patterns) {
+            for (const QSize& size : {QSize(1, 1), QSize(7, 3), QSize(1, 300), QSize(333, 128), QSize(517, 301)}) {
+                QTest::addRow("%s %dx%d", name, size.width(), size.height()) << pattern << size;
+            }
+        }
+    }
+
+    // lossless from a padded view, into an image of another size
+    void roundTrip() {
+        QFETCH(Pattern, pattern);
+        QFETCH(QSize, size);
+        const QImage backing = patternImage(pattern, size.width() + 9, size.height() + 2);
+        const QImage view = captureView(backing, QRect(QPoint(4, 1), size));
+
+        const QByteArray data = encoded(view);
+        QImage decoded(5, 5, QImage::Format_RGB32);
+        QVERIFY(decode(data, decoded));
+        QCOMPARE(decoded.size(), size);
+        QCOMPARE(decoded, view.copy());
+
+        // and again into the now matching allocation
+        const uchar* bits = decoded.constBits();
+        decoded.fill(Qt::black);
+        QVERIFY(decode(data, decoded));
+        QVERIFY(decoded.constBits() == bits);
+        QCOMPARE(decoded, view.copy());
+    }
+
+    // every prefix of a file is rejected, whichever part it cuts
+    void truncated() {
+        const QByteArray data = encoded(patternImage(Pattern::Gradient, 61, 300));
+        QImage decoded;
+        for (qsizetype size = 0; size < data.size(); ++size) {
+            QVERIFY2(!decode(data.left(size), decoded),
+                     qPrintable(QString("%1 of %2 bytes").arg(size).arg(data.size())));
+        }
+        QVERIFY(decode(data, decoded));
+    }
+
+    void corruptHeader() {
+        const QByteArray good = encoded(patternImage(Pattern::Noise, 40, 300));
+        const uchar* table = reinterpret_cast<const uchar*>(good.constData()) + kHeaderSize;
+        QImage decoded;
+        QVERIFY(decode(good, decoded));
+
+        QByteArray data = good;
+        data[7] = '2';
+        QVERIFY2(!decode(data, decoded), "magic");
+
+        for (quint32 width : {0u, 65536u}) {
+            data = good;
+            qToLittleEndian<quint32>(width, bytes(data) + 8);
+            QVERIFY2(!decode(data, decoded), qPrintable(QString("width %1").arg(width)));
+        }
+        data = good;
+        qToLittleEndian<quint32>(0, bytes(data) + 12);
+        QVERIFY2(!decode(data, decoded), "height 0");
+
+        // 300 rows are three bands
+        for (quint32 bands : {0u, 2u, 4u, 0xffffffffu}) {
+            data = good;
+            qToLittleEndian<quint32>(bands, bytes(data) + 16);
+            QVERIFY2(!decode(data, decoded), qPrintable(QString("%1 bands").arg(bands)));
+        }
+        // a taller image than the bands cover
+        data = good;
+        qToLittleEndian<quint32>(400, bytes(data) + 12);
+        QVERIFY2(!decode(data, decoded), "height past the bands");
+
+        // offsets out of order, and past the payload
+        data = good;
+        qToLittleEndian<quint64>(qFromLittleEndian<quint64>(table + 16) + 1, bytes(data) + kHeaderSize + 8);
+        QVERIFY2(!decode(data, decoded), "descending offsets");
+        data = good;
+        qToLittleEndian<quint64>(quint64(-8), bytes(data) + kHeaderSize + 8);
+        QVERIFY2(!decode(data, decoded), "huge offset");
+        data = good;
+        qToLittleEndian<quint64>(qFromLittleEndian<quint64>(table + 24) + 1, bytes(data) + kHeaderSize + 24);
+        QVERIFY2(!decode(data, decoded), "end past the payload");
+    }
+
+    void corruptBand() {
+        // a black pixel is one run op, the only payload byte
+        QImage black(1, 1, QImage::Format_RGB32);
+        black.fill(Qt::black);
+        const QByteArray good = encoded(black);
+        QCOMPARE(uchar(good.back()), uchar(0xc0));
+        QImage decoded;
+        QVERIFY(decode(good, decoded));
+
+        QByteArray data = good;
+        data.back() = char(0xff);
+        QVERIFY2(!decode(data, decoded), "RGBA op");
+        data.back() = char(0xc1);
+        QVERIFY2(!decode(data, decoded), "run past the band");
+        data.back() = char(0xfe);
+        QVERIFY2(!decode(data, decoded), "RGB op without its bytes");
+        data.back() = char(0x80);
+        QVERIFY2(!decode(data, decoded), "luma op without its second byte");
+    }
+
+    // flipped payload bytes decode to something or fail, never read or
+    // write out of bounds (run under a sanitizer to be sure)
+    void corruptPayload() {
+        const QImage image = patternImage(Pattern::Alternating, 93, 260);
+        const QByteArray good = encoded(image);
+        const qsizetype payload = kHeaderSize + 4 * 8;
+        quint32 state = 12345;
+        QImage decoded;
+        for (int i = 0; i < 2000; ++i) {
+            QByteArray data = good;
+            for (int flips = 0; flips < 4; ++flips) {
+                state = state * 1664525u + 1013904223u;
+                const qsizetype at = payload + qsizetype(state >> 8) % (good.size() - payload);
+                data[at] = char(data[at] ^ (1 << (state & 7)));
+            }
+            if (decode(data, decoded)) QCOMPARE(decoded.size(), image.size());
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(SnapshotTest)
+#include "snapshot_test.moc"
@@ -0,0 +1,109 @@
+#include <QImage>
+#include <QTest>
+#include <QThreadPool>
+
+#include "visionfilter.h"
+
+Q_DECLARE_METATYPE(VisionMode)
+
+namespace {
+
+QImage noiseImage(int width, int height) {
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 state = 0x9e3779b9;
+    for (int y = 0; y < height; ++y) {
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            row[x] = 0xff000000 | (state >> 8);
+        }
+    }
+    return image;
+}
+
+// first differing pixel, or an empty string
+QString compare(const QImage& actual, const QImage& expected) {
+    if (actual.size() != expected.size()) return "size differs";
+    for (int y = 0; y < actual.height(); ++y) {
+        const QRgb* a = reinterpret_cast<const QRgb*>(actual.constScanLine(y));
+        const QRgb* e = reinterpret_cast<const QRgb*>(expected.constScanLine(y));
+        for (int x = 0; x < actual.width(); ++x) {
+            if (a[x] != e[x]) {
+                return QString("(%1, %2): %3, expected %4")
+                    .arg(x)
+                    .arg(y)
+                    .arg(a[x], 8, 16, QChar('0'))
+                    .arg(e[x], 8, 16, QChar('0'));
+            }
+        }
+    }
+    return QString();
+}
+
+}  // namespace
+
+class VisionFilterTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void matchesReference_data() {
+        QTest::addColumn<VisionMode>("mode");
+        QTest::addColumn<QSize>("size");
+        QTest::addColumn<int>("threads");
+        for (int m = 0; m < kVisionModeCount; ++m) {
+            const VisionMode mode = static_cast<VisionMode>(m);
+            // widths around the 8-pixel vector step, one tile and many
+            for (const QSize& size : {QSize(1, 1), QSize(7, 3), QSize(8, 5), QSize(33, 17), QSize(517, 301)}) {
+                for (int threads : {1, 4}) {
+                    QTest::addRow("%s %dx%d, %d threads", qPrintable(visionModeName(mode)), size.width(),
+                                  size.height(), threads)
+                        << mode << size << threads;
+                }
+            }
+        }
+    }
+
+    // the tiled (and, where the CPU has it, AVX2) path pixel for pixel
+    // against the single-threaded scalar one, from a padded source view
+    void matchesReference() {
+        QFETCH(VisionMode, mode);
+        QFETCH(QSize, size);
+        QFETCH(int, threads);
+
+        const QImage backing = noiseImage(size.width() + 13, size.height() + 4);
+        const QImage view(backing.constBits() + 2 * backing.bytesPerLine() + 5 * 4, size.width(), size.height(),
+                          backing.bytesPerLine(), QImage::Format_RGB32);
+
+        QThreadPool* pool = QThreadPool::globalInstance();
+        const int maxThreads = pool->maxThreadCount();
+        pool->setMaxThreadCount(threads);
+        // a destination of another size is replaced
+        QImage filtered(3, 3, QImage::Format_RGB32);
+        applyVisionFilter(view, filtered, mode);
+        pool->setMaxThreadCount(maxThreads);
+
+        QImage reference;
+        applyVisionFilterReference(view, reference, mode);
+        const QString error = compare(filtered, reference);
+        QVERIFY2(error.isEmpty(), qPrintable(error));
+        if (mode == VisionMode::Normal) QCOMPARE(filtered, view.copy());
+    }
+
+    // greys are unchanged by the color-blindness matrices, up to the output quantisation
+    void greysStayGrey() {
+        QImage greys(256, 1, QImage::Format_RGB32);
+        for (int v = 0; v < 256; ++v) greys.setPixel(v, 0, qRgb(v, v, v));
+        for (VisionMode mode : {VisionMode::Protanopia, VisionMode::Deuteranopia, VisionMode::Tritanopia}) {
+            QImage filtered;
+            applyVisionFilter(greys, filtered, mode);
+            for (int v = 0; v < 256; ++v) {
+                const QRgb p = filtered.pixel(v, 0);
+                QVERIFY2(qAbs(qRed(p) - v) <= 2 && qAbs(qGreen(p) - v) <= 2 && qAbs(qBlue(p) - v) <= 2,
+                         qPrintable(QString("%1: grey %2").arg(visionModeName(mode)).arg(v)));
+            }
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(VisionFilterTest)
+#include "visionfilter_test.moc"
@@ -0,0 +1,116 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QThread>
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start(const QString& path) {
+    QMutexLocker fileLocker(&fileMutex_);
+    file_.close();
+    QMutexLocker locker(&mutex_);
+    path_ = path;
+    events_.clear();
+    events_.reserve(4096);
+    flushedEvents_ = 0;
+    dropped_ = 0;
+    clock_.start();
+    enabled_.store(true, std::memory_order_release);
+}
+
+// small stable ids per thread, named once when first seen
+int Tracer::currentThread() {
+    static std::atomic<int> nextId{1};
+    thread_local int id = 0;
+    if (id == 0) {
+        id = nextId.fetch_add(1);
+        QCoreApplication* app = QCoreApplication::instance();
+        const bool gui = app && QThread::currentThread() == app->thread();
+        threadNames_.insert(id, gui ? QString("gui") : QString("worker %1").arg(id));
+    }
+    return id;
+}
+
+void Tracer::record(const char* name, qint64 startNs, qint64 endNs, const QString& detail) {
+    QMutexLocker locker(&mutex_);
+    if (flushedEvents_ + events_.size() >= kMaxEvents) {
+        ++dropped_;
+        return;
+    }
+    events_.push_back({name, startNs, endNs - startNs, currentThread(), detail});
+}
+
+bool Tracer::flush() {
+    if (!isEnabled()) return false;
+
+    // take what is new, recording goes on while it is written
+    std::vector<Event> events;
+    QMap<int, QString> threadNames;
+    qint64 dropped = 0;
+    QString path;
+    {
+        QMutexLocker locker(&mutex_);
+        events.swap(events_);
+        threadNames.swap(threadNames_);
+        flushedEvents_ += events.size();
+        dropped = dropped_;
+        path = path_;
+    }
+
+    QMutexLocker locker(&fileMutex_);
+    if (!file_.isOpen()) {
+        file_.setFileName(path);
+        if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning().noquote() << "trace: cannot write" << path;
+            return false;
+        }
+        file_.write("{\"traceEvents\":[");
+        trailerPos_ = file_.pos();
+        firstEntry_ = true;
+    }
+
+    // one event per line, the trailer written last closes the array and the object
+    QByteArray chunk;
+    auto append = [&](const QJsonObject& entry) {
+        if (!firstEntry_) chunk += ',';
+        firstEntry_ = false;
+        chunk += '\n';
+        chunk += QJsonDocument(entry).toJson(QJsonDocument::Compact);
+    };
+    const qint64 pid = QCoreApplication::applicationPid();
+    for (auto it = threadNames.constBegin(); it != threadNames.constEnd(); ++it) {
+        append(QJsonObject{{"name", "thread_name"},
+                           {"ph", "M"},
+                           {"pid", pid},
+                           {"tid", it.key()},
+                           {"args", QJsonObject{{"name", it.value()}}}});
+    }
+    for (const Event& event : events) {
+        QJsonObject entry{{"name", event.name},
+                          {"cat", "colorpicker"},
+                          {"ph", "X"},
+                          {"ts", event.startNs / 1000.0},
+                          {"dur", event.durationNs / 1000.0},
+                          {"pid", pid},
+                          {"tid", event.thread}};
+        if (!event.detail.isEmpty()) entry["args"] = QJsonObject{{"detail", event.detail}};
+        append(entry);
+    }
+    const qint64 trailerPos = trailerPos_ + chunk.size();
+    chunk += QString("\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%1}}\n").arg(dropped).toLatin1();
+
+    if (!file_.seek(trailerPos_) || file_.write(chunk) != chunk.size() || !file_.resize(file_.pos()) || !file_.flush()) {
+        qWarning().noquote() << "trace: cannot write" << path;
+        return false;
+    }
+    trailerPos_ = trailerPos;
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <vector>
+
+// Span recorder written out as Chrome trace-event JSON (load it in
+// chrome://tracing or ui.perfetto.dev). Nothing is recorded until start();
+// a span on a disabled tracer costs one atomic load.
+class Tracer {
+   public:
+    static Tracer& instance();
+
+    // record from now on and append to path on every flush()
+    void start(const QString& path);
+    bool isEnabled() const { return enabled_.load(std::memory_order_acquire); }
+
+    // ns since start(), the clock all spans use
+    qint64 now() const { return clock_.nsecsElapsed(); }
+
+    // one complete event; name must be a string literal, thread-safe
+    void record(const char* name, qint64 startNs, qint64 endNs, const QString& detail = QString());
+
+    // appends the events recorded since the last flush to the output file,
+    // which stays valid JSON after every call
+    bool flush();
+
+   private:
+    struct Event {
+        const char* name;
+        qint64 startNs;
+        qint64 durationNs;
+        int thread;
+        QString detail;
+    };
+
+    // bounded so a long-running tray session cannot grow without limit
+    static constexpr size_t kMaxEvents = 1 << 20;
+
+    int currentThread();
+
+    std::atomic<bool> enabled_{false};
+    QElapsedTimer clock_;
+    QString path_;
+    QMutex mutex_;
+    std::vector<Event> events_;  // not flushed yet
+    QMap<int, QString> threadNames_;  // not flushed yet
+    size_t flushedEvents_ = 0;
+    qint64 dropped_ = 0;
+
+    // the output file, held open; the closing part is rewritten at trailerPos_
+    QMutex fileMutex_;
+    QFile file_;
+    qint64 trailerPos_ = 0;
+    bool firstEntry_ = true;
+};
+
+// Records the time from construction to destruction as one event.
+class TraceSpan {
+   public:
+    explicit TraceSpan(const char* name)
+        : name_(name), startNs_(Tracer::instance().isEnabled() ? Tracer::instance().now() : -1) {}
+
+    ~TraceSpan() {
+        if (startNs_ >= 0) Tracer::instance().record(name_, startNs_, Tracer::instance().now(), detail_);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // shown as args.detail, e.g. the backend name
+    void setDetail(const QString& detail) {
+        if (startNs_ >= 0) detail_ = detail;
+    }
+
+   private:
+    const char* name_;
+    qint64 startNs_;
+    QString detail_;
+};
@@ -0,0 +1,227 @@
+#include "visionfilter.h"
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "trace.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// steps of the linear-light output tables, fine enough that neighbouring
+// entries never skip an 8-bit sRGB value
+constexpr int kOutSteps = 4096;
+// rows per tile: enough tiles to balance the pool, few enough to stay cheap
+constexpr int kTileRows = 64;
+
+// Per mode: a 3x3 matrix applied to linear RGB, then one lookup per output
+// channel that returns that channel already shifted into place. The
+// luminance view uses the same kernel with the luminance weights in every
+// row, its tables hold the band colors.
+struct VisionTables {
+    float matrix[9];
+    float toLinear[256];
+    quint32 out[3][kOutSteps];
+};
+
+float srgbToLinear(float v) {
+    return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float v) {
+    return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+}
+
+// turbo-like ramp, dark to bright
+constexpr QRgb kLuminanceBands[10] = {
+    0xff30123b, 0xff4454c4, 0xff4490fe, 0xff1fc8de, 0xff29efa2,
+    0xff7dff56, 0xffc1f334, 0xfff1ca3a, 0xfffe922a, 0xffea4f0d,
+};
+
+void buildTables(VisionMode mode, VisionTables& t) {
+    static constexpr float kMatrices[3][9] = {
+        // protanopia
+        {0.152286f, 1.052583f, -0.204868f, 0.114503f, 0.786281f, 0.099216f, -0.003882f, -0.048116f, 1.051998f},
+        // deuteranopia
+        {0.367322f, 0.860646f, -0.227968f, 0.280085f, 0.672501f, 0.047413f, -0.011820f, 0.042940f, 0.968881f},
+        // tritanopia
+        {1.255528f, -0.076749f, -0.178779f, -0.078411f, 0.930809f, 0.147602f, 0.004733f, 0.691367f, 0.303900f},
+    };
+    static constexpr float kLuminance[3] = {0.2126f, 0.7152f, 0.0722f};
+
+    for (int v = 0; v < 256; ++v) t.toLinear[v] = srgbToLinear(v / 255.0f);
+
+    if (mode == VisionMode::Luminance) {
+        for (int row = 0; row < 3; ++row) std::copy(kLuminance, kLuminance + 3, t.matrix + row * 3);
+        for (int i = 0; i < kOutSteps; ++i) {
+            // contrast ratio against black, (Y + 0.05) / 0.05, from 1 to 21
+            const float y = float(i) / (kOutSteps - 1);
+            const float position = std::log((y + 0.05f) / 0.05f) / std::log(21.0f);
+            const QRgb band = kLuminanceBands[std::clamp(int(position * 10), 0, 9)];
+            t.out[0][i] = 0xff000000 | (band & 0xff0000);
+            t.out[1][i] = band & 0x00ff00;
+            t.out[2][i] = band & 0x0000ff;
+        }
+        return;
+    }
+
+    if (mode == VisionMode::Normal) {
+        static constexpr float kIdentity[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+        std::copy(kIdentity, kIdentity + 9, t.matrix);
+    } else {
+        const float* matrix = kMatrices[int(mode) - int(VisionMode::Protanopia)];
+        std::copy(matrix, matrix + 9, t.matrix);
+    }
+    for (int i = 0; i < kOutSteps; ++i) {
+        const quint32 s = quint32(std::lround(linearToSrgb(float(i) / (kOutSteps - 1)) * 255.0f));
+        t.out[0][i] = 0xff000000 | s << 16;
+        t.out[1][i] = s << 8;
+        t.out[2][i] = s;
+    }
+}
+
+const VisionTables& tables(VisionMode mode) {
+    // about 50 KB per mode, built once on first use
+    static const std::vector<VisionTables> all = []() {
+        std::vector<VisionTables> result(kVisionModeCount);
+        for (int m = 0; m < kVisionModeCount; ++m) buildTables(VisionMode(m), result[m]);
+        return result;
+    }();
+    return all[int(mode)];
+}
+
+// the multiply and add order is the same in every kernel, so they agree exactly
+inline int outIndex(float v) {
+    v = std::min(std::max(v, 0.0f), 1.0f);
+    return int(v * float(kOutSteps - 1) + 0.5f);
+}
+
+inline QRgb filterPixel(QRgb p, const VisionTables& t) {
+    const float r = t.toLinear[qRed(p)];
+    const float g = t.toLinear[qGreen(p)];
+    const float b = t.toLinear[qBlue(p)];
+    const float* m = t.matrix;
+    return t.out[0][outIndex(m[0] * r + m[1] * g + m[2] * b)] |
+           t.out[1][outIndex(m[3] * r + m[4] * g + m[5] * b)] |
+           t.out[2][outIndex(m[6] * r + m[7] * g + m[8] * b)];
+}
+
+void filterRowScalar(const QRgb* src, QRgb* dst, int width, const VisionTables& t) {
+    for (int x = 0; x < width; ++x) dst[x] = filterPixel(src[x], t);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLORPICKER_HAVE_AVX2_VISION_KERNEL
+// eight pixels at a time, the table lookups are gathers
+__attribute__((target("avx2"))) void filterRowAvx2(const QRgb* src, QRgb* dst, int width, const VisionTables& t) {
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(float(kOutSteps - 1));
+    const __m256 half = _mm256_set1_ps(0.5f);
+    __m256 m[9];
+    for (int i = 0; i < 9; ++i) m[i] = _mm256_set1_ps(t.matrix[i]);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        const __m256 r = _mm256_i32gather_ps(t.toLinear, _mm256_and_si256(_mm256_srli_epi32(p, 16), byteMask), 4);
+        const __m256 g = _mm256_i32gather_ps(t.toLinear, _mm256_and_si256(_mm256_srli_epi32(p, 8), byteMask), 4);
+        const __m256 b = _mm256_i32gather_ps(t.toLinear, _mm256_and_si256(p, byteMask), 4);
+
+        __m256i out = _mm256_setzero_si256();
+        for (int c = 0; c < 3; ++c) {
+            __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[c * 3], r), _mm256_mul_ps(m[c * 3 + 1], g)),
+                                     _mm256_mul_ps(m[c * 3 + 2], b));
+            v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+            const __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), half));
+            out = _mm256_or_si256(out, _mm256_i32gather_epi32(reinterpret_cast<const int*>(t.out[c]), index, 4));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), out);
+    }
+    for (; x < width; ++x) dst[x] = filterPixel(src[x], t);
+}
+#endif
+
+using FilterRowFn = void (*)(const QRgb*, QRgb*, int, const VisionTables&);
+
+FilterRowFn selectFilterRow() {
+#ifdef COLORPICKER_HAVE_AVX2_VISION_KERNEL
+    if (__builtin_cpu_supports("avx2")) return filterRowAvx2;
+#endif
+    return filterRowScalar;
+}
+
+// plain pointers, so workers never touch the QImage (and its detach logic)
+struct Rows {
+    const uchar* src;
+    qsizetype srcStride;
+    uchar* dst;
+    qsizetype dstStride;
+    int width;
+};
+
+void filterRows(const Rows& rows, int first, int last, const VisionTables& t, FilterRowFn filterRow) {
+    for (int y = first; y < last; ++y) {
+        filterRow(reinterpret_cast<const QRgb*>(rows.src + y * rows.srcStride),
+                  reinterpret_cast<QRgb*>(rows.dst + y * rows.dstStride), rows.width, t);
+    }
+}
+
+Rows prepare(const QImage& src, QImage& dst) {
+    Q_ASSERT(src.format() == QImage::Format_RGB32 || src.format() == QImage::Format_ARGB32);
+    if (dst.size() != src.size() || dst.format() != QImage::Format_RGB32) {
+        dst = QImage(src.size(), QImage::Format_RGB32);
+    }
+    return {src.constBits(), src.bytesPerLine(), dst.bits(), dst.bytesPerLine(), src.width()};
+}
+
+}  // namespace
+
+QString visionModeName(VisionMode mode) {
+    switch (mode) {
+        case VisionMode::Normal: return "Normal";
+        case VisionMode::Protanopia: return "Protanopia";
+        case VisionMode::Deuteranopia: return "Deuteranopia";
+        case VisionMode::Tritanopia: return "Tritanopia";
+        case VisionMode::Luminance: return "Luminance Contrast";
+    }
+    return QString();
+}
+
+void applyVisionFilter(const QImage& src, QImage& dst, VisionMode mode) {
+    static const FilterRowFn filterRow = selectFilterRow();
+    const Rows rows = prepare(src, dst);
+    if (mode == VisionMode::Normal) {
+        for (int y = 0; y < src.height(); ++y) {
+            memcpy(rows.dst + y * rows.dstStride, rows.src + y * rows.srcStride, size_t(rows.width) * 4);
+        }
+        return;
+    }
+
+    TraceSpan span("vision filter");
+    span.setDetail(visionModeName(mode));
+    const VisionTables& t = tables(mode);
+
+    std::vector<std::pair<int, int>> tiles;
+    for (int y = 0; y < src.height(); y += kTileRows) tiles.push_back({y, std::min(src.height(), y + kTileRows)});
+    if (tiles.size() == 1 || QThreadPool::globalInstance()->maxThreadCount() == 1) {
+        filterRows(rows, 0, src.height(), t, filterRow);
+    } else {
+        QtConcurrent::blockingMap(tiles, [&](const std::pair<int, int>& tile) {
+            filterRows(rows, tile.first, tile.second, t, filterRow);
+        });
+    }
+}
+
+void applyVisionFilterReference(const QImage& src, QImage& dst, VisionMode mode) {
+    filterRows(prepare(src, dst), 0, src.height(), tables(mode), filterRowScalar);
+}
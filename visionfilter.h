@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QImage>
+#include <QString>
+
+// what the frozen overlay shows; picks always copy the real colors
+enum class VisionMode {
+    Normal,
+    Protanopia,    // no long-wavelength cones
+    Deuteranopia,  // no medium-wavelength cones
+    Tritanopia,    // no short-wavelength cones
+    Luminance      // false-color bands of relative luminance
+};
+
+constexpr int kVisionModeCount = 5;
+
+QString visionModeName(VisionMode mode);
+
+// dst becomes src (RGB32) as seen in mode, same size; Normal is a plain
+// copy. Color blindness is the Machado et al. (2009) full-severity matrix in
+// linear RGB. The luminance view splits relative luminance into 10 bands of
+// equal contrast ratio (about 1.36:1 each), so two areas 5 bands apart meet
+// WCAG AA (4.5:1). Lookup tables do the sRGB conversions; the image is cut
+// into row tiles that run in the global pool, each with an AVX2 kernel where
+// the CPU has one.
+void applyVisionFilter(const QImage& src, QImage& dst, VisionMode mode);
+
+// single-threaded scalar path, to check the fast one against
+void applyVisionFilterReference(const QImage& src, QImage& dst, VisionMode mode);